@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// 分块布隆过滤器（split block bloom filter）
+// 每个块正好 32 字节（8 个 32 位字），一个 key 只落在一个块里：一次查询最多访问一条 cache line
+// 块内 8 个字各置一位，位置由同一个 32 位哈希分别乘 8 个奇数常量后取高 5 位得到，没有数据相关的分支，编译器可以向量化
+// 只会误判“可能存在”，不会漏判：返回 false 的 key 一定没有插入过
+// 位数组使用 relaxed 原子操作，插入和查询可以并发进行
+class BloomFilter {
+public:
+    // expectedKeys: 预计的 key 数量，按每个 key 约 16 位分配（误判率约 0.1%）
+    explicit BloomFilter(size_t expectedKeys) {
+        numBlocks_ = expectedKeys * 16 / 256 + 1;
+        blocks_.reset(new Block[numBlocks_]); // 块按 32 字节对齐，不会跨 cache line
+        for (size_t i = 0; i < numBlocks_; ++i) {
+            for (auto& word : blocks_[i].words) {
+                word.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    BloomFilter(const BloomFilter&) = delete;
+    BloomFilter& operator=(const BloomFilter&) = delete;
+
+    void insert(const std::string& key) {
+        uint64_t h = hash(key);
+        std::atomic<uint32_t>* block = blockFor(h);
+        uint32_t masks[8];
+        makeMasks(static_cast<uint32_t>(h), masks);
+        for (int i = 0; i < 8; ++i) {
+            block[i].fetch_or(masks[i], std::memory_order_relaxed);
+        }
+    }
+
+    // false 表示一定不存在；true 表示可能存在，需要再查数据库确认
+    bool mayContain(const std::string& key) const {
+        uint64_t h = hash(key);
+        const std::atomic<uint32_t>* block = blockFor(h);
+        uint32_t masks[8];
+        makeMasks(static_cast<uint32_t>(h), masks);
+        uint32_t missing = 0;
+        for (int i = 0; i < 8; ++i) {
+            missing |= masks[i] & ~block[i].load(std::memory_order_relaxed);
+        }
+        return missing == 0;
+    }
+
+    size_t sizeBytes() const { return numBlocks_ * 32; }
+
+private:
+    struct alignas(32) Block {
+        std::atomic<uint32_t> words[8];
+    };
+
+    size_t numBlocks_;
+    std::unique_ptr<Block[]> blocks_;
+
+    // 64 位哈希：FNV-1a 后再做一次 splitmix64 混合，让高低 32 位都足够均匀
+    static uint64_t hash(const std::string& key) {
+        uint64_t h = 14695981039346656037ULL;
+        for (unsigned char c : key) {
+            h = (h ^ c) * 1099511628211ULL;
+        }
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return h;
+    }
+
+    // 高 32 位选块：乘法取高位代替取模
+    std::atomic<uint32_t>* blockFor(uint64_t h) const {
+        uint64_t index = ((h >> 32) * numBlocks_) >> 32;
+        return blocks_[index].words;
+    }
+
+    // 低 32 位生成块内 8 个字各自的掩码
+    static void makeMasks(uint32_t key, uint32_t masks[8]) {
+        static const uint32_t kSalt[8] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                          0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+        for (int i = 0; i < 8; ++i) {
+            masks[i] = 1U << ((key * kSalt[i]) >> 27);
+        }
+    }
+};
@@ -0,0 +1,171 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+// 登录凭据缓存：username -> (密码哈希, 盐值)
+// 按用户名哈希分成多个分片，每个分片一把读写锁，查询只加共享锁，不同分片之间互不影响
+// 淘汰策略为 CLOCK：命中时只设置一个原子引用位（共享锁下即可完成），淘汰时指针转一圈，清掉引用位、淘汰没被再次访问的条目
+// 不存在的用户也会被缓存（负缓存），但只保留很短时间，避免刚注册的用户长时间登录不了
+class CredentialCache {
+public:
+    enum class Lookup {
+        Miss,    // 缓存中没有，需要查数据库
+        Found,   // 用户存在，hash/salt 已填充
+        Unknown  // 最近查询过，用户不存在
+    };
+
+    // capacity: 总条目数，平均分到各分片
+    // negativeTtl: 负缓存的有效期
+    explicit CredentialCache(size_t capacity = 65536,
+                             std::chrono::milliseconds negativeTtl = std::chrono::milliseconds(2000))
+        : negativeTtl_(negativeTtl) {
+        size_t perShard = capacity / kShards > 0 ? capacity / kShards : 1;
+        for (auto& shard : shards_) {
+            shard.slots.reset(new Slot[perShard]);
+            shard.capacity = perShard;
+        }
+    }
+
+    CredentialCache(const CredentialCache&) = delete;
+    CredentialCache& operator=(const CredentialCache&) = delete;
+
+    // 查询缓存
+    Lookup get(const std::string& username, std::string& hash, std::string& salt) {
+        Shard& shard = shardFor(username);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.index.find(username);
+        if (it == shard.index.end()) {
+            return Lookup::Miss;
+        }
+        Slot& slot = shard.slots[it->second];
+        if (slot.negative) {
+            if (std::chrono::steady_clock::now() >= slot.expires) {
+                return Lookup::Miss; // 负缓存已过期，由下次 put 覆盖
+            }
+            slot.referenced.store(true, std::memory_order_relaxed);
+            return Lookup::Unknown;
+        }
+        slot.referenced.store(true, std::memory_order_relaxed);
+        hash = slot.hash;
+        salt = slot.salt;
+        return Lookup::Found;
+    }
+
+    // 查数据库之前取得的版本号，负缓存写入时用来判断期间是否有注册发生
+    uint64_t version(const std::string& username) {
+        return shardFor(username).version.load(std::memory_order_acquire);
+    }
+
+    // 缓存一个已存在的用户
+    void put(const std::string& username, const std::string& hash, const std::string& salt) {
+        Shard& shard = shardFor(username);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        Slot& slot = slotFor(shard, username);
+        slot.hash = hash;
+        slot.salt = salt;
+        slot.negative = false;
+    }
+
+    // 缓存一个不存在的用户；如果查数据库期间这个分片发生过失效（有人注册），放弃写入，避免缓存过时的“不存在”
+    void putNegative(const std::string& username, uint64_t versionBeforeQuery) {
+        Shard& shard = shardFor(username);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        if (shard.version.load(std::memory_order_relaxed) != versionBeforeQuery) {
+            return;
+        }
+        Slot& slot = slotFor(shard, username);
+        slot.hash.clear();
+        slot.salt.clear();
+        slot.negative = true;
+        slot.expires = std::chrono::steady_clock::now() + negativeTtl_;
+    }
+
+    // 用户数据发生写入（注册、改密码）后调用
+    void invalidate(const std::string& username) {
+        Shard& shard = shardFor(username);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        shard.version.fetch_add(1, std::memory_order_release);
+        auto it = shard.index.find(username);
+        if (it == shard.index.end()) {
+            return;
+        }
+        Slot& slot = shard.slots[it->second];
+        slot.used = false;
+        slot.key.clear();
+        slot.hash.clear();
+        slot.salt.clear();
+        shard.index.erase(it);
+    }
+
+private:
+    static constexpr size_t kShards = 16;
+
+    struct Slot {
+        std::string key;
+        std::string hash;
+        std::string salt;
+        bool used = false;
+        bool negative = false;
+        std::chrono::steady_clock::time_point expires;
+        std::atomic<bool> referenced{false}; // CLOCK 引用位，共享锁下由读者设置
+    };
+
+    struct alignas(64) Shard {
+        std::shared_mutex mutex;
+        std::unordered_map<std::string, size_t> index; // username -> 槽位下标
+        std::unique_ptr<Slot[]> slots;
+        size_t capacity = 0;
+        size_t hand = 0;                                // CLOCK 指针
+        std::atomic<uint64_t> version{0};               // 每次失效加一
+    };
+
+    Shard shards_[kShards];
+    std::chrono::milliseconds negativeTtl_;
+
+    Shard& shardFor(const std::string& username) {
+        size_t h = std::hash<std::string>()(username);
+        return shards_[(h ^ (h >> 32)) % kShards];
+    }
+
+    // 找到 username 的槽位，没有则按 CLOCK 选一个槽位给它（持有独占锁）
+    Slot& slotFor(Shard& shard, const std::string& username) {
+        auto it = shard.index.find(username);
+        if (it != shard.index.end()) {
+            Slot& slot = shard.slots[it->second];
+            slot.referenced.store(true, std::memory_order_relaxed);
+            return slot;
+        }
+
+        // 转动指针：空槽直接使用；有引用位的清掉引用位给第二次机会；否则淘汰
+        size_t victim;
+        while (true) {
+            Slot& slot = shard.slots[shard.hand];
+            size_t pos = shard.hand;
+            shard.hand = (shard.hand + 1) % shard.capacity;
+            if (!slot.used) {
+                victim = pos;
+                break;
+            }
+            if (slot.referenced.exchange(false, std::memory_order_relaxed)) {
+                continue;
+            }
+            shard.index.erase(slot.key);
+            victim = pos;
+            break;
+        }
+
+        Slot& slot = shard.slots[victim];
+        slot.key = username;
+        slot.used = true;
+        slot.referenced.store(false, std::memory_order_relaxed);
+        shard.index[username] = victim;
+        return slot;
+    }
+};
@@ -1,67 +1,63 @@
 #pragma once
 #include <sqlite3.h>
 #include <string>
+#include <algorithm>
+#include <memory>
 #include <mutex>
+#include <thread>
+#include <functional>
+#include <future>
 #include <unordered_map>
 #include <stdexcept>
-#include <iomanip>
-#include <sstream>
-#include <openssl/rand.h>  // 用于生成随机盐值
 
 #include <openssl/sha.h>  // 如果需要hashPassword
-// #include <openssl/evp.h>
-// #include <openssl/err.h>
 
+#include "Logger.h"
+#include "ThreadPool.h"
+#include "PasswordHasher.h"
 #include "SQLiteConnectionPool.h"
+#include "WriteBatcher.h"
+#include "CredentialCache.h"
+#include "BloomFilter.h"
 
 class Database {
 private:
-    std::mutex dbMutex;                // 保护数据库操作的互斥锁
-    std::mutex preparedStatementMutex; // 保护preparedStatements的互斥锁
-    std::unordered_map<std::string, sqlite3_stmt*> preparedStatements;
-
-    SQLiteConnectionPool pool;
+    static constexpr size_t kReaderConnections = 20; // 只读连接数上限，也是数据库执行器的线程数
     std::string dbPath;
-        // 生成一个随机盐值
-    std::string generateSalt(size_t length = 16) {
-        unsigned char salt[length];
-        if (!RAND_bytes(salt, length)) {
-            throw std::runtime_error("Failed to generate salt");
-        }
-
-        std::ostringstream oss;
-        oss << std::hex << std::setw(2) << std::setfill('0');
-        for (int i = 0; i < length; ++i) {
-            oss << (int)salt[i];
-        }
-
-        return oss.str();
-    }
-
-    // 哈希密码和盐值
-    std::string hashPasswordWithSalt(const std::string& password, const std::string& salt) {
-        std::string saltedPassword = password + salt;
-        unsigned char hash[SHA256_DIGEST_LENGTH];
-        SHA256(reinterpret_cast<const unsigned char*>(saltedPassword.data()), 
-               saltedPassword.size(), 
-               hash);
-
-        std::ostringstream oss;
-        oss << std::hex << std::setw(2) << std::setfill('0');
-        for (int i = 0; i < SHA256_DIGEST_LENGTH; ++i) {
-            oss << std::setw(2) << std::setfill('0') << (int)hash[i];
-        }
-        return oss.str();
-    }
+    // WAL 模式下的读写分离：一个写连接（注册之间互相串行），多个只读连接（登录并行执行）
+    // 声明顺序决定构造顺序：写连接先创建数据库并开启 WAL，再打开只读连接
+    SQLiteConnectionPool writer;
+    SQLiteConnectionPool readers;
+    // 登录凭据缓存，热点用户登录不再访问连接池
+    CredentialCache credentials;
+    // 全部用户名的布隆过滤器，启动时从 users 表构建；一定不存在的用户名不访问数据库
+    std::unique_ptr<BloomFilter> usernames;
+    // 密码哈希算法（PBKDF2-SHA256，参数随盐值一起保存）
+    PasswordHasher hasher;
+    // 注册请求合并提交：多个 INSERT 放在同一个事务里
+    // 析构顺序与声明顺序相反：dbExecutor -> crypto -> registrations -> 上面的状态 -> 连接池
+    // 前一个线程池析构时执行完的任务会投递给后一个，写线程析构时提交剩余写操作，完成回调会访问 credentials，
+    // 所以 registrations 声明在它们和 writer 之后，比它们先析构
+    WriteBatcher registrations;
+    // 专用的加密线程池：KDF 只在这里计算，线程数与核数相同，队列有上限
+    // 撞库流量把队列打满时新请求直接失败，不会占满处理请求的线程、也不会无限排队
+    ThreadPool crypto;
+    // 数据库执行器：线程数与只读连接池上限相同，查库的任务不会因为等连接而阻塞
+    // 在 crypto 之后声明（先析构）：它的任务会继续投递到 crypto
+    ThreadPool dbExecutor;
 
 public:
     Database(const std::string& db_path) 
         : dbPath(db_path),
-          // 假设最小连接数 5，最大连接数 20
-          pool(db_path, 5, 20) 
+          writer(db_path, 1, 1),
+          // 只读连接：最小 5，最大 kReaderConnections
+          readers(db_path, 5, kReaderConnections, 30, SQLiteConnectionPool::AccessMode::ReadOnly),
+          registrations(writer),
+          crypto(std::max(2u, std::thread::hardware_concurrency()), 1024),
+          dbExecutor(kReaderConnections, 4096)
     {
         // 初始化数据库表
-        auto conn = pool.getConnection();  // RAII句柄
+        auto conn = writer.getConnection();  // RAII句柄
         sqlite3* db = conn.get();
 
         const char* sql = 
@@ -79,6 +75,8 @@ public:
             sqlite3_free(errmsg);
             throw std::runtime_error("Failed to create table: " + errCopy);
         }
+
+        loadUsernames();
     }
 
     // 简单的SHA256 hash函数
@@ -88,95 +86,247 @@ public:
                password.size(), 
                hash);
 
-        std::ostringstream oss;
-        oss << std::hex << std::setw(2) << std::setfill('0');
-        for (int i = 0; i < SHA256_DIGEST_LENGTH; ++i) {
-            oss << std::setw(2) << std::setfill('0') << (int)hash[i];
-        }
-        return oss.str();
+        return PasswordHasher::toHex(hash, sizeof(hash));
     }
 
-    // 获取或者创建一个预编译stmt
-    sqlite3_stmt* getPreparedStatement(sqlite3* db, const std::string& sql) {
-        std::lock_guard<std::mutex> statementLock(preparedStatementMutex);
+    // 异步接口的完成回调，参数为操作结果
+    // 回调在数据库执行器、加密线程池或写线程上调用，调用方需要自己把结果转回所在的线程（例如 reactor）
+    using Callback = std::function<void(bool)>;
 
-        auto it = preparedStatements.find(sql);
-        if (it != preparedStatements.end()) {
-            // 已经准备好过，直接返回
-            return it->second;
-        }
-        // 还没准备过，创建一个新的
-        sqlite3_stmt* stmt = nullptr;
-        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-            return nullptr;
-        }
-        preparedStatements[sql] = stmt;
-        return stmt;
+    // 同步注册：提交异步注册并等待结果
+    bool registerUser(const std::string& username, const std::string& password) {
+        std::promise<bool> result;
+        registerUserAsync(username, password, [&result](bool ok) { result.set_value(ok); });
+        return result.get_future().get();
     }
 
-     bool registerUser(const std::string& username, const std::string& password) {
-        std::lock_guard<std::mutex> guard(dbMutex);
+    // 同步登录：提交异步登录并等待结果
+    bool loginUser(const std::string& username, const std::string& password) {
+        std::promise<bool> result;
+        loginUserAsync(username, password, [&result](bool ok) { result.set_value(ok); });
+        return result.get_future().get();
+    }
 
-        // 从连接池获取连接（默认超时5000ms）
-        auto conn = pool.getConnection();  
-        sqlite3* db = conn.get();
+    // 异步注册：查重（需要时）在数据库执行器上，哈希在加密线程池上，INSERT 由写线程合并提交，全程不阻塞调用线程
+    void registerUserAsync(const std::string& username, const std::string& password, Callback done) {
+        auto state = std::make_shared<Request>(Request{username, password, "", "", std::move(done)});
 
-        sqlite3_stmt* stmt = getPreparedStatement(db, 
-            "INSERT INTO users (username, password, salt) VALUES (?, ?, ?);");
-        if (!stmt) {
-            return false;
+        // 布隆过滤器说“可能存在”时，查库确认；确实已存在才跳过注定失败的 INSERT（误判时照常注册）
+        if (!usernames->mayContain(username)) {
+            hashAndInsert(state);
+            return;
+        }
+        if (credentials.get(username, state->hash, state->salt) == CredentialCache::Lookup::Found) {
+            state->done(false);
+            return;
+        }
+        post(dbExecutor, state, [this, state] {
+            CredentialCache::Lookup result;
+            try {
+                result = queryCredentials(state->username, state->hash, state->salt);
+            } catch (const std::exception& e) {
+                // 取连接超时、打开/配置连接失败：任务的 future 没有人等待，这里不结束请求，连接就永远得不到响应
+                LOG_ERROR("registerUser: %s", e.what());
+                state->done(false);
+                return;
+            }
+            if (result == CredentialCache::Lookup::Found) {
+                state->done(false);
+                return;
+            }
+            hashAndInsert(state);
+        });
+    }
+
+    // 异步登录：过滤器和缓存在调用线程上判断（纳秒级），查库在数据库执行器上，校验密码在加密线程池上
+    void loginUserAsync(const std::string& username, const std::string& password, Callback done) {
+        // 一定不存在的用户名直接失败，不查缓存也不访问连接池（撞库流量中的随机用户名大多在这里被挡掉）
+        if (!usernames->mayContain(username)) {
+            done(false);
+            return;
         }
 
-        // 生成盐值
-        std::string salt = generateSalt();
+        auto state = std::make_shared<Request>(Request{username, password, "", "", std::move(done)});
 
-        // 使用盐值对密码进行哈希加盐
-        std::string hashed_password = hashPasswordWithSalt(password, salt);
+        // 再查缓存：命中时不访问连接池；最近确认过不存在的用户直接失败
+        auto cached = credentials.get(username, state->hash, state->salt);
+        if (cached == CredentialCache::Lookup::Unknown) {
+            state->done(false);
+            return;
+        }
+        if (cached == CredentialCache::Lookup::Found) {
+            verifyPassword(state);
+            return;
+        }
 
-        // 绑定参数
-        sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 2, hashed_password.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 3, salt.c_str(), -1, SQLITE_STATIC);
+        post(dbExecutor, state, [this, state] {
+            // 查库之前记下版本号，期间若有注册发生则不写负缓存
+            uint64_t version = credentials.version(state->username);
+            CredentialCache::Lookup result;
+            try {
+                result = queryCredentials(state->username, state->hash, state->salt);
+            } catch (const std::exception& e) {
+                LOG_ERROR("loginUser: %s", e.what());
+                state->done(false);
+                return;
+            }
+            if (result == CredentialCache::Lookup::Found) {
+                credentials.put(state->username, state->hash, state->salt);
+                verifyPassword(state);
+            } else {
+                if (result == CredentialCache::Lookup::Unknown) {
+                    credentials.putNegative(state->username, version);
+                }
+                state->done(false); // 用户不存在或查询出错（出错不缓存）
+            }
+        });
+    }
 
-        if (sqlite3_step(stmt) != SQLITE_DONE) {
-            sqlite3_reset(stmt);
-            return false;
+private:
+    // 一次异步注册/登录的状态，在各个执行器之间传递
+    struct Request {
+        std::string username;
+        std::string password;
+        std::string hash; // 存储的（登录）或新计算的（注册）密码哈希
+        std::string salt; // 带算法参数的盐值字段
+        Callback done;
+    };
+
+    // 把任务放到执行器上；队列已满时立即以失败结束请求（过载时快速失败，而不是无限排队）
+    template <class F>
+    void post(ThreadPool& executor, const std::shared_ptr<Request>& state, F&& task) {
+        try {
+            executor.enqueue(std::forward<F>(task));
+        } catch (const std::exception& e) {
+            LOG_ERROR("Database executor: %s", e.what());
+            state->done(false);
         }
+    }
 
-        sqlite3_reset(stmt);
-        return true; 
+    // 在加密线程池中生成盐值（含算法参数）并计算哈希，然后交给写线程合并提交
+    void hashAndInsert(const std::shared_ptr<Request>& state) {
+        post(crypto, state, [this, state] {
+            try {
+                state->salt = hasher.newSaltField();
+                state->hash = hasher.hash(state->password, state->salt);
+            } catch (const std::exception& e) {
+                LOG_ERROR("registerUser: %s", e.what());
+                state->done(false);
+                return;
+            }
+
+            // 先加入布隆过滤器再提交：注册返回成功时，后续登录一定能通过过滤器（INSERT 失败时多出的位只会增加误判）
+            usernames->insert(state->username);
+
+            // 交给写线程，与同一时间段的其它注册合并到一个事务中提交；state 在完成回调之前一直有效
+            registrations.submit([state](SQLiteConnectionPool::Connection& conn) {
+                // 预编译语句缓存在连接上，stmt 析构时自动 reset 并清空绑定
+                auto stmt = conn.prepare("INSERT INTO users (username, password, salt) VALUES (?, ?, ?);");
+                if (!stmt) {
+                    return false;
+                }
+
+                // 绑定参数
+                sqlite3_bind_text(stmt.get(), 1, state->username.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_text(stmt.get(), 2, state->hash.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_text(stmt.get(), 3, state->salt.c_str(), -1, SQLITE_STATIC);
+
+                // 用户名重复时 UNIQUE 冲突只让这一行失败
+                return sqlite3_step(stmt.get()) == SQLITE_DONE;
+            }, [this, state](bool ok) {
+                if (ok) {
+                    // 写后失效：清掉该用户的负缓存
+                    credentials.invalidate(state->username);
+                }
+                state->done(ok); // 事务提交后返回本行的结果
+            });
+        });
     }
 
-    // 修改loginUser来支持盐值
-    bool loginUser(const std::string& username, const std::string& password) {
-        std::lock_guard<std::mutex> guard(dbMutex);
+    // 在加密线程池中按存储的参数校验密码；参数已过时则顺便按当前参数重新计算
+    void verifyPassword(const std::shared_ptr<Request>& state) {
+        post(crypto, state, [this, state] {
+            bool verified = false;
+            try {
+                verified = hasher.verify(state->password, state->salt, state->hash);
+                if (verified && hasher.needsRehash(state->salt)) {
+                    std::string newSalt = hasher.newSaltField();
+                    upgradeCredentials(state->username, state->salt, hasher.hash(state->password, newSalt), newSalt);
+                }
+            } catch (const std::exception& e) {
+                LOG_ERROR("loginUser: %s", e.what());
+            }
+            state->done(verified);
+        });
+    }
 
-        auto conn = pool.getConnection();
-        sqlite3* db = conn.get();
+    // 把登录成功用户的哈希升级为当前参数：交给写线程异步更新，不等待结果
+    // 只在盐值未被其它请求修改时更新；缓存立即换成新值（新旧两组值都能校验同一个密码）
+    void upgradeCredentials(const std::string& username, const std::string& oldSalt,
+                            const std::string& newHash, const std::string& newSalt) {
+        registrations.submit([username, oldSalt, newHash, newSalt](SQLiteConnectionPool::Connection& conn) {
+            auto stmt = conn.prepare("UPDATE users SET password = ?, salt = ? WHERE username = ? AND salt = ?;");
+            if (!stmt) {
+                return false;
+            }
+            sqlite3_bind_text(stmt.get(), 1, newHash.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt.get(), 2, newSalt.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt.get(), 3, username.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt.get(), 4, oldSalt.c_str(), -1, SQLITE_STATIC);
+            return sqlite3_step(stmt.get()) == SQLITE_DONE;
+        });
+        credentials.put(username, newHash, newSalt);
+    }
 
-        std::string sql = "SELECT password, salt FROM users WHERE username = ?;";
-        sqlite3_stmt* stmt = nullptr;
+    // 启动时读取全部用户名构建布隆过滤器，按现有用户数的 2 倍（至少 100 万）预留容量
+    void loadUsernames() {
+        auto conn = readers.getConnection();
+        size_t count = 0;
+        {
+            auto stmt = conn.prepare("SELECT COUNT(*) FROM users;");
+            if (stmt && sqlite3_step(stmt.get()) == SQLITE_ROW) {
+                count = static_cast<size_t>(sqlite3_column_int64(stmt.get(), 0));
+            }
+        }
+        usernames.reset(new BloomFilter(std::max<size_t>(count * 2, 1 << 20)));
 
-        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-            return false;
+        auto stmt = conn.prepare("SELECT username FROM users;");
+        if (!stmt) {
+            throw std::runtime_error("Failed to load usernames");
+        }
+        while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+            const unsigned char* name = sqlite3_column_text(stmt.get(), 0);
+            if (name) {
+                usernames->insert(reinterpret_cast<const char*>(name));
+            }
         }
+    }
 
-        sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_STATIC);
+    // 从只读连接查询用户的哈希和盐值；用户不存在返回 Unknown，查询出错返回 Miss
+    CredentialCache::Lookup queryCredentials(const std::string& username, std::string& hash, std::string& salt) {
+        // 只读连接，多个登录请求可以同时查询
+        auto conn = readers.getConnection();
 
-        if (sqlite3_step(stmt) != SQLITE_ROW) {
-            sqlite3_finalize(stmt);
-            return false;
+        // 复用连接上缓存的语句，不再每次 prepare/finalize
+        auto stmt = conn.prepare("SELECT password, salt FROM users WHERE username = ?;");
+        if (!stmt) {
+            return CredentialCache::Lookup::Miss;
         }
 
-        const unsigned char* stored_pass = sqlite3_column_text(stmt, 0);
-        const unsigned char* stored_salt = sqlite3_column_text(stmt, 1);
-        std::string dbStoredHash = stored_pass ? reinterpret_cast<const char*>(stored_pass) : "";
-        std::string dbStoredSalt = stored_salt ? reinterpret_cast<const char*>(stored_salt) : "";
+        sqlite3_bind_text(stmt.get(), 1, username.c_str(), -1, SQLITE_STATIC);
 
-        sqlite3_finalize(stmt);
+        int rc = sqlite3_step(stmt.get());
+        if (rc == SQLITE_DONE) {
+            return CredentialCache::Lookup::Unknown;
+        }
+        if (rc != SQLITE_ROW) {
+            return CredentialCache::Lookup::Miss;
+        }
 
-        // 使用盐值和密码进行哈希比较
-        std::string hashed_password = hashPasswordWithSalt(password, dbStoredSalt);
-        return (hashed_password == dbStoredHash);
-    }
+        const unsigned char* stored_pass = sqlite3_column_text(stmt.get(), 0);
+        const unsigned char* stored_salt = sqlite3_column_text(stmt.get(), 1);
+        hash = stored_pass ? reinterpret_cast<const char*>(stored_pass) : "";
+        salt = stored_salt ? reinterpret_cast<const char*>(stored_salt) : "";
+        return CredentialCache::Lookup::Found;
+    } // stmt 先于 conn 析构：reset 结束读事务后再归还连接
 };
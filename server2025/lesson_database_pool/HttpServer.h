@@ -2,10 +2,14 @@
 
 #include <sys/socket.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <fcntl.h>
 #include <netinet/in.h>
 #include <unistd.h>
 #include <cstring>
+#include <mutex>
+#include <utility>
+#include <vector>
 #include "Logger.h"
 #include "ThreadPool.h"
 #include "Router.h"
@@ -16,7 +20,7 @@
 class HttpServer {
 public:
     HttpServer(int port, int max_events, Database& db) 
-        : server_fd(-1), epollfd(-1), port(port), max_events(max_events), db(db) {}
+        : server_fd(-1), epollfd(-1), completion_fd(-1), port(port), max_events(max_events), db(db) {}
 
     void start() {
         setupServerSocket();
@@ -30,6 +34,8 @@ public:
             for (int n = 0; n < nfds; ++n) {
                 if (events[n].data.fd == server_fd) {
                     acceptConnection();
+                } else if (events[n].data.fd == completion_fd) {
+                    flushCompletions(); // 异步请求已完成，在 reactor 线程上发送响应
                 } else {
                     // 使用线程池异步处理连接
                     pool.enqueue([fd = events[n].data.fd, this]() {
@@ -52,10 +58,14 @@ public:
     }
 
 private:
-    int server_fd, epollfd, port, max_events;
+    int server_fd, epollfd, completion_fd, port, max_events;
     Router router;
     Database& db;
 
+    // 已完成的异步请求：(fd, 响应报文)，由任意线程放入，reactor 线程取出发送
+    std::mutex completionMutex;
+    std::vector<std::pair<int, std::string>> completions;
+
     void setupServerSocket() {
         server_fd = socket(AF_INET, SOCK_STREAM, 0);
         struct sockaddr_in address = {};
@@ -78,6 +88,43 @@ private:
         event.events = EPOLLIN | EPOLLET;
         event.data.fd = server_fd;
         epoll_ctl(epollfd, EPOLL_CTL_ADD, server_fd, &event);
+
+        // eventfd 用来唤醒 reactor：异步请求完成时写入，reactor 读到后发送响应
+        completion_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        event.events = EPOLLIN;
+        event.data.fd = completion_fd;
+        epoll_ctl(epollfd, EPOLL_CTL_ADD, completion_fd, &event);
+    }
+
+    // 异步请求完成（在数据库/加密线程上调用）：把响应交给 reactor
+    void postCompletion(int fd, std::string response) {
+        bool wake;
+        {
+            std::lock_guard<std::mutex> lock(completionMutex);
+            wake = completions.empty(); // 已有未处理的完成项时 reactor 必然会被唤醒，不必重复写 eventfd
+            completions.emplace_back(fd, std::move(response));
+        }
+        if (wake) {
+            uint64_t one = 1;
+            ssize_t n = write(completion_fd, &one, sizeof(one));
+            (void)n;
+        }
+    }
+
+    // reactor 线程：发送所有已完成请求的响应并关闭连接
+    void flushCompletions() {
+        uint64_t count;
+        ssize_t n = read(completion_fd, &count, sizeof(count));
+        (void)n;
+        std::vector<std::pair<int, std::string>> ready;
+        {
+            std::lock_guard<std::mutex> lock(completionMutex);
+            ready.swap(completions);
+        }
+        for (auto& item : ready) {
+            send(item.first, item.second.c_str(), item.second.length(), MSG_NOSIGNAL);
+            close(item.first); // Close connection after handling
+        }
     }
 
     void acceptConnection() {
@@ -87,7 +134,7 @@ private:
         while ((client_sock = accept(server_fd, (struct sockaddr *)&client_addr, &client_addrlen)) > 0) {
             setNonBlocking(client_sock);
             struct epoll_event event = {};
-            event.events = EPOLLIN | EPOLLET;
+            event.events = EPOLLIN | EPOLLET | EPOLLONESHOT; // 每次事件只交给一个处理者
             event.data.fd = client_sock;
             epoll_ctl(epollfd, EPOLL_CTL_ADD, client_sock, &event);
         }
@@ -96,17 +143,32 @@ private:
         }
     }
 
+    // 连接以 EPOLLONESHOT 注册：一次事件之后不会再有事件，连接只属于当前的工作线程，
+    // 交给异步路由后只属于完成回调（flushCompletions），只有它会发送响应并关闭 fd
     void handleConnection(int fd) {
         char buffer[4096];
         ssize_t bytes_read;
+        bool served = false;
         while ((bytes_read = read(fd, buffer, sizeof(buffer) - 1)) > 0) {
             buffer[bytes_read] = '\0';
             HttpRequest request;
             if (request.parse(buffer)) {
+                if (router.isAsync(request)) {
+                    // 异步路由：连接交给完成回调，工作线程不等待数据库，立即返回处理下一个连接
+                    router.routeAsync(request, [this, fd](HttpResponse response) {
+                        postCompletion(fd, response.toString());
+                    });
+                    return;
+                }
                 HttpResponse response = router.routeRequest(request);
                 std::string response_str = response.toString();
                 send(fd, response_str.c_str(), response_str.length(), 0);
             }
+            served = true;
+        }
+        if (bytes_read == -1 && errno == EAGAIN && !served) {
+            rearm(fd); // 还没有数据（虚假唤醒），重新等待可读
+            return;
         }
         if (bytes_read == -1 && errno != EAGAIN) {
             LOG_ERROR("Error reading from socket %d", fd);
@@ -114,6 +176,14 @@ private:
         close(fd); // Close connection after handling
     }
 
+    // 重新启用一次性事件：连接交还给 epoll
+    void rearm(int fd) {
+        struct epoll_event event = {};
+        event.events = EPOLLIN | EPOLLET | EPOLLONESHOT;
+        event.data.fd = fd;
+        epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &event);
+    }
+
     void setNonBlocking(int sock) {
         int flags = fcntl(sock, F_GETFL, 0);
         flags |= O_NONBLOCK;
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+
+// 密码哈希（KDF）
+// 盐值字段里同时保存算法和参数，格式为 "算法$迭代次数$盐值hex"，例如 "pbkdf2-sha256$100000$9f3a..."
+// 旧数据的盐值字段只有盐值本身（没有 '$'），按原来的 SHA256(password + salt) 校验
+// 提高迭代次数后，老用户在下次登录成功时按新参数重新计算（needsRehash），不需要一次性迁移
+class PasswordHasher {
+public:
+    explicit PasswordHasher(uint32_t iterations = 100000) : iterations_(iterations) {}
+
+    // 为新密码生成盐值字段（带当前算法和参数）
+    std::string newSaltField() const {
+        unsigned char salt[16];
+        if (!RAND_bytes(salt, sizeof(salt))) {
+            throw std::runtime_error("Failed to generate salt");
+        }
+        return "pbkdf2-sha256$" + std::to_string(iterations_) + "$" + toHex(salt, sizeof(salt));
+    }
+
+    // 按盐值字段中记录的算法和参数计算哈希（hex）
+    std::string hash(const std::string& password, const std::string& saltField) const {
+        uint32_t iterations;
+        std::string salt;
+        if (!parse(saltField, iterations, salt)) {
+            // 旧格式：SHA256(password + salt)
+            std::string saltedPassword = password + saltField;
+            unsigned char digest[SHA256_DIGEST_LENGTH];
+            SHA256(reinterpret_cast<const unsigned char*>(saltedPassword.data()), saltedPassword.size(), digest);
+            return toHex(digest, sizeof(digest));
+        }
+        unsigned char digest[32];
+        if (!PKCS5_PBKDF2_HMAC(password.data(), static_cast<int>(password.size()),
+                               reinterpret_cast<const unsigned char*>(salt.data()), static_cast<int>(salt.size()),
+                               static_cast<int>(iterations), EVP_sha256(), sizeof(digest), digest)) {
+            throw std::runtime_error("PBKDF2 failed");
+        }
+        return toHex(digest, sizeof(digest));
+    }
+
+    // 校验密码，比较时间与内容无关
+    bool verify(const std::string& password, const std::string& saltField, const std::string& storedHash) const {
+        return constantTimeEquals(hash(password, saltField), storedHash);
+    }
+
+    // 存储的参数是否弱于当前参数（旧格式或迭代次数较低）
+    bool needsRehash(const std::string& saltField) const {
+        uint32_t iterations;
+        std::string salt;
+        return !parse(saltField, iterations, salt) || iterations < iterations_;
+    }
+
+    // 查表法 hex 编码，不经过 iostream
+    static std::string toHex(const unsigned char* data, size_t len) {
+        static const char kDigits[] = "0123456789abcdef";
+        std::string out(len * 2, '\0');
+        for (size_t i = 0; i < len; ++i) {
+            out[2 * i] = kDigits[data[i] >> 4];
+            out[2 * i + 1] = kDigits[data[i] & 0x0f];
+        }
+        return out;
+    }
+
+    // 长度不是秘密，可以先比较；内容用 CRYPTO_memcmp 逐字节比较完，不因第一个不同字节提前返回
+    static bool constantTimeEquals(const std::string& a, const std::string& b) {
+        return a.size() == b.size() && CRYPTO_memcmp(a.data(), b.data(), a.size()) == 0;
+    }
+
+private:
+    uint32_t iterations_;
+
+    // 解析 "pbkdf2-sha256$迭代次数$盐值"，旧格式返回 false
+    static bool parse(const std::string& saltField, uint32_t& iterations, std::string& salt) {
+        static const std::string kPrefix = "pbkdf2-sha256$";
+        if (saltField.compare(0, kPrefix.size(), kPrefix) != 0) {
+            return false;
+        }
+        size_t sep = saltField.find('$', kPrefix.size());
+        if (sep == std::string::npos) {
+            return false;
+        }
+        iterations = static_cast<uint32_t>(std::strtoul(saltField.c_str() + kPrefix.size(), nullptr, 10));
+        salt = saltField.substr(sep + 1);
+        return iterations > 0;
+    }
+};
@@ -9,11 +9,34 @@ class Router {
 public:
     // 定义处理函数的类型
     using HandlerFunc = std::function<HttpResponse(const HttpRequest&)>;
+    // 异步处理函数：立即返回，操作完成后调用 respond 发送响应（可以在任意线程上调用，只能调用一次）
+    using Responder = std::function<void(HttpResponse)>;
+    using AsyncHandlerFunc = std::function<void(const HttpRequest&, Responder)>;
 
     // 添加路由：将 HTTP 方法和路径映射到处理函数
     void addRoute(const std::string& method, const std::string& path, HandlerFunc handler) {
         routes[method + "|" + path] = handler;
     }
+
+    // 添加异步路由：处理函数不在工作线程上等待结果
+    void addAsyncRoute(const std::string& method, const std::string& path, AsyncHandlerFunc handler) {
+        asyncRoutes[method + "|" + path] = handler;
+    }
+
+    // 请求是否对应一个异步路由
+    bool isAsync(const HttpRequest& request) const {
+        return asyncRoutes.count(request.getMethodString() + "|" + request.getPath()) > 0;
+    }
+
+    // 分发到异步路由，没有对应的异步路由时返回 false
+    bool routeAsync(const HttpRequest& request, Responder respond) const {
+        auto it = asyncRoutes.find(request.getMethodString() + "|" + request.getPath());
+        if (it == asyncRoutes.end()) {
+            return false;
+        }
+        it->second(request, std::move(respond));
+        return true;
+    }
         std::string readFile(const std::string& filePath) {
         // 使用标准库中的ifstream打开文件
         std::ifstream file(filePath);
@@ -46,30 +69,34 @@ public:
 
     // 设置数据库相关的路由，例如注册和登录
     void setupDatabaseRoutes(Database& db) {
-        // 注册路由
-        addRoute("POST", "/register", [&db](const HttpRequest& req) {
+        // 注册路由：异步执行，工作线程提交后立即返回
+        addAsyncRoute("POST", "/register", [&db](const HttpRequest& req, Responder respond) {
             auto params = req.parseFormBody();  // 解析表单数据
             std::string username = params["username"];
             std::string password = params["password"];
-            // 调用数据库方法进行用户注册
-            if (db.registerUser(username, password)) {
-                return HttpResponse::makeOkResponse("Register Success!");
-            } else {
-                return HttpResponse::makeErrorResponse(400, "Register Failed!");
-            }
+            // 调用数据库方法进行用户注册，完成后回调发送响应
+            db.registerUserAsync(username, password, [respond](bool ok) {
+                if (ok) {
+                    respond(HttpResponse::makeOkResponse("Register Success!"));
+                } else {
+                    respond(HttpResponse::makeErrorResponse(400, "Register Failed!"));
+                }
+            });
         });
 
-        // 登录路由
-        addRoute("POST", "/login", [&db](const HttpRequest& req) {
+        // 登录路由：异步执行，工作线程提交后立即返回
+        addAsyncRoute("POST", "/login", [&db](const HttpRequest& req, Responder respond) {
             auto params = req.parseFormBody();  // 解析表单数据
             std::string username = params["username"];
             std::string password = params["password"];
-            // 调用数据库方法进行用户登录
-            if (db.loginUser(username, password)) {
-                return HttpResponse::makeOkResponse("Login Success!");
-            } else {
-                return HttpResponse::makeErrorResponse(400, "Login Failed!");
-            }
+            // 调用数据库方法进行用户登录，完成后回调发送响应
+            db.loginUserAsync(username, password, [respond](bool ok) {
+                if (ok) {
+                    respond(HttpResponse::makeOkResponse("Login Success!"));
+                } else {
+                    respond(HttpResponse::makeErrorResponse(400, "Login Failed!"));
+                }
+            });
         });
     }
     void setupFileRoutes(const std::string& uploadDir = "uploads") {
@@ -116,4 +143,5 @@ public:
             }
 private:
     std::unordered_map<std::string, HandlerFunc> routes;  // 存储路由映射
+    std::unordered_map<std::string, AsyncHandlerFunc> asyncRoutes;  // 存储异步路由映射
 };
@@ -4,49 +4,77 @@
 #include <mutex>
 #include <condition_variable>
 #include <chrono>
-#include <atomic>
 #include <stdexcept>
-#include <unordered_map>
+#include <string>
+#include <thread>
 #include <sqlite3.h>
+#include "StatementCache.h"
 
 // 定义SQLite数据库连接池类
 class SQLiteConnectionPool {
 public:
+    // 连接的访问方式
+    // ReadWrite：WAL 模式的读写连接，一个数据库只应有一个这样的池（通常 maxSize = 1），写操作之间互相串行
+    // ReadOnly：只读连接，WAL 模式下读不阻塞写、写也不阻塞读，多个读连接可以在多个核上并行查询
+    enum class AccessMode { ReadWrite, ReadOnly };
+
     // 构造函数：初始化连接池的参数
     // dbPath: 数据库文件路径
     // minSize: 最小连接数，默认为5
     // maxSize: 最大连接数，默认为50
     // checkIntervalSec: 连接池维护线程检查空闲连接的时间间隔，单位秒，默认为30秒
-    SQLiteConnectionPool(const std::string& dbPath, 
+    // mode: 连接的访问方式，只读池要在读写池建好数据库之后再创建
+    SQLiteConnectionPool(const std::string& dbPath,
                          size_t minSize = 5,
                          size_t maxSize = 50,
-                         int checkIntervalSec = 30)
+                         int checkIntervalSec = 30,
+                         AccessMode mode = AccessMode::ReadWrite)
         : dbPath_(dbPath), // 数据库路径
           minSize_(minSize), // 最小连接数
           maxSize_(maxSize), // 最大连接数
           checkInterval_(checkIntervalSec), // 维护线程检查间隔
+          mode_(mode), // 访问方式
           running_(true) {  // 线程池运行状态，默认为true
         initializePool(); // 初始化连接池
         startMaintenanceThread(); // 启动维护线程
     }
 
-    // 析构函数：停止线程池并清理资源
+    // 析构函数：停止维护线程并清理资源
     ~SQLiteConnectionPool() {
-        running_ = false; // 设置停止标志，通知维护线程退出
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false; // 设置停止标志
+        }
+        maintenanceCv_.notify_one(); // 立即唤醒维护线程，不必等到下一个检查周期
         if (maintenanceThread_.joinable()) {
             maintenanceThread_.join(); // 等待维护线程结束
         }
         cleanup(); // 清理资源
     }
 
+    // 池中的一个连接：SQLite 连接本身、它自己的预编译语句缓存和使用时间
+    // 语句缓存与连接同生共死，连接关闭前先 finalize 全部语句
+    struct PooledConnection {
+        sqlite3* db;
+        StatementCache statements;
+        std::chrono::steady_clock::time_point lastUsed;      // 最后一次归还的时间，用于回收空闲连接
+        std::chrono::steady_clock::time_point lastValidated; // 最后一次确认连接可用的时间
+
+        explicit PooledConnection(sqlite3* db)
+            : db(db), statements(db),
+              lastUsed(std::chrono::steady_clock::now()), lastValidated(lastUsed) {}
+        ~PooledConnection() {
+            statements.clear();
+            sqlite3_close(db);
+        }
+    };
+
     // 内部Connection类，用于表示连接池中的连接
+    // 访问连接不再记录时间（原来每次 get()/-> 都要加锁更新一个 map），只在归还时记一次
     class Connection {
     public:
-        // 构造函数：初始化连接并更新最后使用时间
-        Connection(sqlite3* conn, SQLiteConnectionPool& pool)
-            : conn_(conn), pool_(pool) {
-            updateLastUsed(); // 更新连接的最后使用时间
-        }
+        Connection(PooledConnection* conn, SQLiteConnectionPool& pool)
+            : conn_(conn), pool_(pool) {}
 
         // 析构函数：连接对象销毁时，将连接返回连接池
         ~Connection() {
@@ -57,96 +85,106 @@ public:
 
         // 重载->运算符，使得可以通过conn->xxx调用SQLite的API
         sqlite3* operator->() const {
-            updateLastUsed(); // 每次访问连接时，更新其最后使用时间
-            return conn_;
+            return conn_->db;
         }
 
         // 返回原始连接
         sqlite3* get() const {
-            updateLastUsed(); // 每次访问连接时，更新其最后使用时间
-            return conn_;
+            return conn_->db;
+        }
+
+        // 从本连接的语句缓存中取出预编译语句，未缓存时编译一次
+        // 返回的句柄析构时自动 reset + clear_bindings，语句本身留在缓存中；编译失败时句柄为空
+        ScopedStatement prepare(const std::string& sql) {
+            return ScopedStatement(conn_->statements.get(sql));
         }
 
         // 判断连接是否有效
-        operator bool() const { 
+        operator bool() const {
             return conn_ != nullptr; // 如果连接为空指针，则返回false
         }
 
     private:
-        // 更新连接的最后使用时间
-        void updateLastUsed() const {
-            auto now = std::chrono::steady_clock::now();
-            std::lock_guard<std::mutex> lock(pool_.timeMutex_);
-            pool_.lastUsedTimes_[conn_] = now; // 更新连接的最后使用时间
-        }
-        
-        sqlite3* conn_;  // SQLite连接对象
+        PooledConnection* conn_;  // 池中的连接（SQLite连接 + 语句缓存）
         SQLiteConnectionPool& pool_;  // 连接池引用
     };
 
     // 获取连接：超时时间为timeoutMs，默认5000ms
+    // 快速路径只有一次无竞争加锁和一次 vector::pop_back；新建连接在锁外进行
     Connection getConnection(int timeoutMs = 5000) {
         std::unique_lock<std::mutex> lock(mutex_);
 
-        // 等待直到连接池中有可用连接或可以创建新的连接
-        if (!cv_.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] {
-            return !pool_.empty() || activeCount_ < maxSize_;
-        })) {
-            throw std::runtime_error("Get connection timeout"); // 超时错误
+        if (idle_.empty() && total_ >= maxSize_) {
+            // 等待直到有连接归还或可以创建新的连接
+            ++waiters_;
+            bool ready = cv_.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] {
+                return !idle_.empty() || total_ < maxSize_;
+            });
+            --waiters_;
+            if (!ready) {
+                throw std::runtime_error("Get connection timeout"); // 超时错误
+            }
         }
 
-        // 从池中获取一个连接
-        if (!pool_.empty()) {
-            auto conn = pool_.back();
-            pool_.pop_back(); // 从池中移除该连接
-            activeCount_++; // 增加活跃连接计数
+        // 从池中获取一个空闲连接（后进先出：最近用过的连接页缓存和语句缓存最热）
+        if (!idle_.empty()) {
+            PooledConnection* conn = idle_.back();
+            idle_.pop_back();
             return Connection(conn, *this);
         }
 
-        // 如果没有可用连接且活跃连接数小于最大连接数，创建新连接
-        if (activeCount_ < maxSize_) {
-            auto conn = createNewConnection();
-            activeCount_++;
-            return Connection(conn, *this);
+        // 没有空闲连接但未达上限：先占住名额，在锁外打开数据库
+        ++total_;
+        lock.unlock();
+        try {
+            return Connection(createNewConnection(), *this);
+        } catch (...) {
+            lock.lock();
+            --total_;
+            if (waiters_ > 0) cv_.notify_one();
+            throw;
         }
-
-        throw std::runtime_error("Connection pool exhausted"); // 如果池已满，抛出错误
     }
 
 private:
     friend class Connection; // Connection类需要访问returnConnection方法
 
+    // 距上次确认可用超过这个时间的连接，归还时重新校验一次
+    static constexpr std::chrono::seconds kValidateAfter{60};
+    // 超过这个时间未使用的空闲连接被回收（保留 minSize 个）
+    static constexpr std::chrono::minutes kIdleTimeout{30};
+
     std::string dbPath_; // 数据库路径
     size_t minSize_; // 最小连接数
     size_t maxSize_; // 最大连接数
     int checkInterval_; // 检查间隔（秒）
-    std::atomic<bool> running_; // 连接池是否正在运行
+    AccessMode mode_; // 读写池或只读池
+    bool running_; // 连接池是否正在运行（mutex_ 保护）
 
-    std::vector<sqlite3*> pool_;  // 存储空闲连接的池
+    std::vector<PooledConnection*> idle_;  // 空闲连接
+    size_t total_ = 0; // 当前连接总数（空闲 + 借出 + 正在创建），mutex_ 保护
+    size_t waiters_ = 0; // 正在等待连接的线程数，没有等待者时归还不调用 notify
     std::mutex mutex_; // 保护连接池的互斥锁
     std::condition_variable cv_; // 条件变量，控制连接获取的同步
+    std::condition_variable maintenanceCv_; // 维护线程的定时等待与停止通知
     std::thread maintenanceThread_; // 维护线程，用于定期清理连接池
-    std::atomic<size_t> activeCount_{0}; // 当前活跃的连接数量
-
-    // 追踪每个连接的最后使用时间
-    std::mutex timeMutex_; 
-    std::unordered_map<sqlite3*, std::chrono::steady_clock::time_point> lastUsedTimes_;
 
     // 初始化连接池：创建最小连接数的连接并放入池中
     void initializePool() {
         std::lock_guard<std::mutex> lock(mutex_);
         for (size_t i = 0; i < minSize_; ++i) {
-            pool_.push_back(createNewConnection()); // 创建新连接并添加到池中
+            idle_.push_back(createNewConnection()); // 创建新连接并添加到池中
+            ++total_;
         }
     }
 
     // 创建新的SQLite连接
-    sqlite3* createNewConnection() {
+    PooledConnection* createNewConnection() {
         sqlite3* conn = nullptr;
+        int flags = mode_ == AccessMode::ReadOnly ? SQLITE_OPEN_READONLY
+                                                  : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
         // 使用sqlite3_open_v2创建新的数据库连接
-        int rc = sqlite3_open_v2(dbPath_.c_str(), &conn,
-                                 SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX,
-                                 nullptr);
+        int rc = sqlite3_open_v2(dbPath_.c_str(), &conn, flags | SQLITE_OPEN_NOMUTEX, nullptr);
         if (rc != SQLITE_OK) {
             // 如果连接失败，打印错误并抛出异常
             std::string err = sqlite3_errmsg(conn);
@@ -155,25 +193,63 @@ private:
         }
         sqlite3_busy_timeout(conn, 5000); // 设置SQLite忙碌超时
 
-        {
-            std::lock_guard<std::mutex> lock(timeMutex_);
-            lastUsedTimes_[conn] = std::chrono::steady_clock::now(); // 记录连接的最后使用时间
+        // 读写连接：开启 WAL（持久化在数据库文件中，只读连接随之生效），synchronous=NORMAL 在 WAL 下仍保证不损坏
+        // 只读连接：query_only 防止误写，mmap 让读直接命中页缓存，省去 read() 拷贝
+        const char* pragmas = mode_ == AccessMode::ReadOnly
+            ? "PRAGMA query_only = 1; PRAGMA mmap_size = 268435456;"
+            : "PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL;";
+        char* errMsg = nullptr;
+        if (sqlite3_exec(conn, pragmas, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+            std::string err = errMsg ? errMsg : "unknown error";
+            sqlite3_free(errMsg);
+            sqlite3_close(conn);
+            throw std::runtime_error("Cannot configure database connection: " + err);
         }
-        return conn;
+        return new PooledConnection(conn);
     }
 
     // 将连接返回连接池
-    void returnConnection(sqlite3* conn) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (checkConnectionValid(conn) && pool_.size() < maxSize_) {
-            pool_.push_back(conn); // 如果连接有效并且池未满，返回连接到池中
+    // 不再每次都执行 SELECT 1：只有最近一次调用出错、残留未结束的事务、或太久没有校验过的连接才校验
+    void returnConnection(PooledConnection* conn) {
+        auto now = std::chrono::steady_clock::now();
+        bool valid = true;
+        if (needsValidation(conn, now)) {
+            valid = checkConnectionValid(conn->db); // 在锁外执行
+            conn->lastValidated = now;
+        }
+        conn->lastUsed = now;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        bool keep = valid && running_;
+        if (keep) {
+            idle_.push_back(conn); // 连接有效，返回池中
         } else {
-            sqlite3_close(conn); // 否则关闭连接
-            activeCount_--; // 活跃连接数减少
-            std::lock_guard<std::mutex> timeLock(timeMutex_);
-            lastUsedTimes_.erase(conn); // 清除该连接的最后使用时间记录
+            --total_; // 否则关闭连接（在锁外）
+        }
+        bool notify = waiters_ > 0;
+        lock.unlock();
+
+        if (!keep) {
+            delete conn; // 释放语句缓存并关闭连接
+        }
+        if (notify) {
+            cv_.notify_one(); // 唤醒一个等待中的线程
+        }
+    }
+
+    // 判断归还的连接是否需要校验
+    static bool needsValidation(PooledConnection* conn, std::chrono::steady_clock::time_point now) {
+        // 调用方没有结束事务：回滚后再校验
+        if (!sqlite3_get_autocommit(conn->db)) {
+            sqlite3_exec(conn->db, "ROLLBACK;", nullptr, nullptr, nullptr);
+            return true;
+        }
+        // 最近一次调用的结果：正常结果和约束冲突（如用户名重复）不算连接出错
+        int rc = sqlite3_errcode(conn->db);
+        if (rc != SQLITE_OK && rc != SQLITE_ROW && rc != SQLITE_DONE && rc != SQLITE_CONSTRAINT) {
+            return true;
         }
-        cv_.notify_one(); // 唤醒一个等待中的线程
+        return now - conn->lastValidated > kValidateAfter;
     }
 
     // 检查连接是否有效
@@ -187,51 +263,72 @@ private:
         return true;
     }
 
-    // 启动维护线程：定期检查连接池并进行维护
+    // 启动维护线程：定期检查连接池并进行维护，析构时通过条件变量立即退出
     void startMaintenanceThread() {
         maintenanceThread_ = std::thread([this] {
+            std::unique_lock<std::mutex> lock(mutex_);
             while (running_) {
-                std::this_thread::sleep_for(std::chrono::seconds(checkInterval_)); // 等待一段时间
+                maintenanceCv_.wait_for(lock, std::chrono::seconds(checkInterval_), [this] { return !running_; });
+                if (!running_) break;
+                lock.unlock();
                 maintainPool(); // 执行连接池维护操作
+                lock.lock();
             }
         });
     }
 
     // 维护连接池：清理过期连接并保持池中连接数满足最小连接数
+    // 打开和关闭连接都在锁外进行，不阻塞取连接的线程
     void maintainPool() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        // 如果池中连接数少于最小值，尝试补充连接
-        while (pool_.size() < minSize_ && (activeCount_ + pool_.size() < maxSize_)) {
-            pool_.push_back(createNewConnection());
+        auto now = std::chrono::steady_clock::now();
+        std::vector<PooledConnection*> expired;
+        size_t toCreate = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // 清理长时间未使用的空闲连接，但保留最小连接数
+            for (auto it = idle_.begin(); it != idle_.end() && total_ > minSize_;) {
+                if (now - (*it)->lastUsed > kIdleTimeout) {
+                    expired.push_back(*it);
+                    it = idle_.erase(it);
+                    --total_;
+                } else {
+                    ++it;
+                }
+            }
+            // 如果空闲连接数少于最小值，补充连接（先占住名额）
+            while (idle_.size() + toCreate < minSize_ && total_ < maxSize_) {
+                ++toCreate;
+                ++total_;
+            }
         }
 
-        // 清理长时间未使用的连接
-        auto now = std::chrono::steady_clock::now();
-        auto it = std::remove_if(pool_.begin(), pool_.end(), [&](sqlite3* conn) {
-            std::lock_guard<std::mutex> timeLock(timeMutex_);
-            auto lastUsed = lastUsedTimes_[conn];
-            // 超过30分钟未使用的连接被认为可以回收
-            return (now - lastUsed) > std::chrono::minutes(30);
-        });
+        for (auto conn : expired) {
+            delete conn; // 释放语句缓存并关闭连接
+        }
 
-        // 关闭被标记为过期的连接
-        for (auto p = it; p != pool_.end(); ++p) {
-            sqlite3_close(*p);
-            activeCount_--;
-            std::lock_guard<std::mutex> timeLock(timeMutex_);
-            lastUsedTimes_.erase(*p);
+        for (size_t i = 0; i < toCreate; ++i) {
+            PooledConnection* conn = nullptr;
+            try {
+                conn = createNewConnection();
+            } catch (const std::exception&) {
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (conn) {
+                idle_.push_back(conn);
+            } else {
+                --total_;
+            }
+            if (waiters_ > 0) cv_.notify_one();
         }
-        pool_.erase(it, pool_.end()); // 从池中移除过期连接
     }
 
     // 清理连接池中的所有连接
     void cleanup() {
         std::lock_guard<std::mutex> lock(mutex_);
-        for (auto conn : pool_) {
-            sqlite3_close(conn); // 关闭所有连接
+        for (auto conn : idle_) {
+            delete conn; // 释放语句缓存并关闭所有连接
         }
-        pool_.clear(); // 清空连接池
-        std::lock_guard<std::mutex> timeLock(timeMutex_);
-        lastUsedTimes_.clear(); // 清空最后使用时间记录
+        total_ -= idle_.size();
+        idle_.clear(); // 清空连接池
     }
 };
@@ -0,0 +1,87 @@
+#pragma once
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <sqlite3.h>
+
+// RAII 语句句柄：离开作用域时自动 reset 并清空绑定参数，语句本身留在缓存中供下次复用
+class ScopedStatement {
+public:
+    explicit ScopedStatement(sqlite3_stmt* stmt = nullptr) : stmt_(stmt) {}
+
+    ~ScopedStatement() {
+        if (stmt_) {
+            sqlite3_reset(stmt_);          // 结束本次执行，释放读事务/写锁
+            sqlite3_clear_bindings(stmt_); // 清空绑定，避免下一次使用时带上残留参数
+        }
+    }
+
+    ScopedStatement(ScopedStatement&& other) noexcept : stmt_(other.stmt_) { other.stmt_ = nullptr; }
+    ScopedStatement(const ScopedStatement&) = delete;
+    ScopedStatement& operator=(const ScopedStatement&) = delete;
+    ScopedStatement& operator=(ScopedStatement&&) = delete;
+
+    sqlite3_stmt* get() const { return stmt_; }
+    explicit operator bool() const { return stmt_ != nullptr; }
+
+private:
+    sqlite3_stmt* stmt_;
+};
+
+// 单个 SQLite 连接的预编译语句缓存（LRU）
+// sqlite3_stmt 属于创建它的连接，所以缓存跟着连接走，而不是全局按 SQL 共享
+// 同一时刻只有借出该连接的线程会访问，不需要加锁
+class StatementCache {
+public:
+    explicit StatementCache(sqlite3* db, size_t capacity = 32) : db_(db), capacity_(capacity) {}
+
+    ~StatementCache() { clear(); }
+
+    StatementCache(const StatementCache&) = delete;
+    StatementCache& operator=(const StatementCache&) = delete;
+
+    // 取得 SQL 对应的语句：命中时移到 LRU 头部，未命中时预编译并在超出容量时淘汰最久未用的语句
+    sqlite3_stmt* get(const std::string& sql) {
+        auto it = index_.find(sql);
+        if (it != index_.end()) {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return it->second->second;
+        }
+
+        sqlite3_stmt* stmt = nullptr;
+        // SQLITE_PREPARE_PERSISTENT：提示 SQLite 该语句会长期保留并反复执行
+        if (sqlite3_prepare_v3(db_, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+            sqlite3_finalize(stmt);
+            return nullptr;
+        }
+        entries_.emplace_front(sql, stmt);
+        index_[sql] = entries_.begin();
+
+        if (entries_.size() > capacity_) {
+            sqlite3_finalize(entries_.back().second);
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+        return stmt;
+    }
+
+    // 释放全部语句（关闭连接之前必须调用）
+    void clear() {
+        for (auto& entry : entries_) {
+            sqlite3_finalize(entry.second);
+        }
+        entries_.clear();
+        index_.clear();
+    }
+
+    size_t size() const { return entries_.size(); }
+
+private:
+    using Entry = std::pair<std::string, sqlite3_stmt*>;
+
+    sqlite3* db_;
+    size_t capacity_;
+    std::list<Entry> entries_;                                          // 头部为最近使用
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_; // SQL -> 链表节点
+};
@@ -0,0 +1,162 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sqlite3.h>
+
+#include "SQLiteConnectionPool.h"
+
+// 写操作合并提交（group commit）
+// 每次单独执行 INSERT 都是一个隐式事务，每个事务都要单独写日志、加锁、提交
+// 这里把写请求放进队列，由一个写线程一次取出最多 maxBatch 个（或等待 maxDelay），在同一个事务里依次执行后一次提交
+// 每个调用方拿到自己的结果（future 或完成回调），是自己那一行的执行结果（例如 UNIQUE 冲突只让这一行失败，不影响同批其它行）
+class WriteBatcher {
+public:
+    // 在写连接上执行的一次写操作，返回 true 表示这一行成功
+    using WriteOp = std::function<bool(SQLiteConnectionPool::Connection&)>;
+    // 事务提交（或失败）后在写线程上调用，参数为这一行的结果
+    using Completion = std::function<void(bool)>;
+
+    // writer: 写连接池（通常只有一个连接）
+    // maxBatch: 每个事务最多包含的写操作数
+    // maxDelay: 收到第一个写操作后最多再等多久凑批
+    WriteBatcher(SQLiteConnectionPool& writer,
+                 size_t maxBatch = 128,
+                 std::chrono::microseconds maxDelay = std::chrono::microseconds(500))
+        : writer_(writer), maxBatch_(maxBatch), maxDelay_(maxDelay) {
+        thread_ = std::thread([this] { run(); });
+    }
+
+    // 析构时先把队列中剩余的写操作提交完再退出
+    ~WriteBatcher() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_one();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    WriteBatcher(const WriteBatcher&) = delete;
+    WriteBatcher& operator=(const WriteBatcher&) = delete;
+
+    // 提交一个写操作，事务提交后 future 才会就绪
+    std::future<bool> submit(WriteOp op) {
+        auto promise = std::make_shared<std::promise<bool>>();
+        std::future<bool> result = promise->get_future();
+        submit(std::move(op), [promise](bool ok) { promise->set_value(ok); });
+        return result;
+    }
+
+    // 提交一个写操作，事务结束后在写线程上调用 done；调用方不需要等待
+    // done 中不要做耗时操作，否则会推迟下一批提交
+    void submit(WriteOp op, Completion done) {
+        Item item{std::move(op), std::move(done)};
+        bool wake;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(item));
+            // 只在队列从空变为非空、或凑满一批时唤醒写线程
+            wake = queue_.size() == 1 || queue_.size() >= maxBatch_;
+        }
+        if (wake) {
+            cv_.notify_one();
+        }
+    }
+
+private:
+    struct Item {
+        WriteOp op;
+        Completion done;
+    };
+
+    SQLiteConnectionPool& writer_;
+    size_t maxBatch_;
+    std::chrono::microseconds maxDelay_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Item> queue_;
+    bool stopping_ = false;
+    std::thread thread_;
+
+    void run() {
+        std::vector<Item> batch;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                break; // stopping_ 且队列已空
+            }
+            // 凑批：直到攒够 maxBatch 个或等满 maxDelay
+            if (queue_.size() < maxBatch_ && !stopping_ && maxDelay_.count() > 0) {
+                cv_.wait_for(lock, maxDelay_, [this] { return stopping_ || queue_.size() >= maxBatch_; });
+            }
+            while (!queue_.empty() && batch.size() < maxBatch_) {
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+            lock.unlock();
+            commitBatch(batch);
+            batch.clear();
+            lock.lock();
+        }
+    }
+
+    // 在一个事务中执行一批写操作
+    void commitBatch(std::vector<Item>& batch) {
+        std::vector<bool> results(batch.size(), false);
+        try {
+            auto conn = writer_.getConnection();
+            sqlite3* db = conn.get();
+
+            // BEGIN IMMEDIATE：一开始就拿写锁，避免中途升级锁失败
+            if (sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+                failAll(batch);
+                return;
+            }
+
+            bool aborted = false;
+            for (size_t i = 0; i < batch.size(); ++i) {
+                // 约束冲突（如 UNIQUE）只回滚这一条语句，事务继续
+                results[i] = batch[i].op(conn);
+                // 磁盘满、I/O 错误等会让 SQLite 自动回滚整个事务，此时整批失败
+                if (sqlite3_get_autocommit(db)) {
+                    aborted = true;
+                    break;
+                }
+            }
+
+            if (aborted || sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+                if (!sqlite3_get_autocommit(db)) {
+                    sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+                }
+                failAll(batch);
+                return;
+            }
+        } catch (const std::exception&) {
+            // 获取写连接超时等
+            failAll(batch);
+            return;
+        }
+
+        // 事务已经提交，逐个通知调用方
+        for (size_t i = 0; i < batch.size(); ++i) {
+            batch[i].done(results[i]);
+        }
+    }
+
+    static void failAll(std::vector<Item>& batch) {
+        for (auto& item : batch) {
+            item.done(false);
+        }
+    }
+};
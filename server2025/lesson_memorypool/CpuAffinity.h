@@ -0,0 +1,105 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <linux/filter.h>
+#include <linux/mempolicy.h>
+#include <cstdlib>
+#include <string>
+#include <sstream>
+#include <vector>
+
+// CPU 亲和性与 NUMA 相关的工具函数
+// 在双路服务器上，线程在不同 CPU 插槽之间迁移、或者访问另一个节点上的内存，都会带来跨节点流量
+// 这里提供：绑核、查询 CPU 所在的 NUMA 节点、把内存绑定到节点、按接收 CPU 把连接分给对应的 reactor
+// 直接使用系统调用，不依赖 libnuma
+
+// 绑核配置：为空表示不绑核，与之前的行为一致
+struct AffinityOptions {
+    std::vector<int> reactorCpus;  // 每个 reactor（epoll 线程）绑定的 CPU，个数即 reactor 个数
+    std::vector<int> workerCpus;   // 工作线程可以绑定的 CPU，按 NUMA 节点分给对应节点的线程池
+    bool numaLocal = false;        // 是否按 NUMA 节点拆分线程池和内存池
+};
+
+// 解析 CPU 列表，格式与 taskset -c 相同，例如 "0-3,8,10-11"
+inline std::vector<int> parseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) continue;
+        size_t dash = item.find('-');
+        int first = std::atoi(item.substr(0, dash).c_str());
+        int last = dash == std::string::npos ? first : std::atoi(item.substr(dash + 1).c_str());
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// 把当前线程绑定到指定 CPU，cpu < 0 时不做任何事
+inline bool pinCurrentThread(int cpu) {
+    if (cpu < 0) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// 查询 CPU 所在的 NUMA 节点（读取 /sys/devices/system/cpu/cpuN/nodeK），无法确定时返回 0
+inline int numaNodeOfCpu(int cpu) {
+    if (cpu < 0) return 0;
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return 0;
+    int node = 0;
+    while (struct dirent* entry = readdir(dir)) {
+        if (std::string(entry->d_name).compare(0, 4, "node") == 0) {
+            node = std::atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+// 当前线程正在运行的 CPU 所在的 NUMA 节点
+inline int currentNumaNode() {
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) return 0;
+    return static_cast<int>(node);
+}
+
+// 让 [addr, addr + len) 的物理页优先从指定节点分配（必须在首次触碰之前调用）
+// 使用 MPOL_PREFERRED 而不是 MPOL_BIND：节点内存不足时回退到其它节点，而不是直接失败
+inline bool bindMemoryToNode(void* addr, size_t len, int node) {
+    if (node < 0 || node >= 64) return false;
+    unsigned long mask = 1UL << node;
+    return syscall(SYS_mbind, addr, len, MPOL_PREFERRED, &mask, 64, 0) == 0;
+}
+
+// 为 SO_REUSEPORT 监听组安装 cBPF 选择程序：按处理该连接 SYN 的 CPU（即网卡 RX 队列中断所在的 CPU）
+// 选择组内的监听套接字。cpuToReactor[cpu] 是该 CPU 对应的 reactor 下标，套接字在组内的顺序与创建顺序一致
+// 只需在组内任意一个套接字上安装一次
+inline bool attachIncomingCpuSteering(int listenFd, const std::vector<int>& cpuToReactor) {
+    std::vector<struct sock_filter> code;
+    // A = 当前 CPU 编号
+    code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)));
+    // 逐个比较：if (A == cpu) return reactor;
+    for (size_t cpu = 0; cpu < cpuToReactor.size(); ++cpu) {
+        code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<uint32_t>(cpu), 0, 1));
+        code.push_back(BPF_STMT(BPF_RET | BPF_K, static_cast<uint32_t>(cpuToReactor[cpu])));
+    }
+    // 表外的 CPU 交给 0 号 reactor
+    code.push_back(BPF_STMT(BPF_RET | BPF_K, 0));
+
+    struct sock_fprog prog = {};
+    prog.len = static_cast<unsigned short>(code.size());
+    prog.filter = code.data();
+    return setsockopt(listenFd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0;
+}
@@ -6,6 +6,8 @@
 #include <netinet/in.h>
 #include <unistd.h>
 #include <cstring>
+#include <set>
+#include <thread>
 #include "Logger.h"
 #include "ThreadPool.h"
 #include "Router.h"
@@ -13,40 +15,48 @@
 #include "HttpResponse.h"
 #include "Database.h"
 #include "MemoryPool.h"  // 引入内存池
+#include "CpuAffinity.h" // 引入绑核与 NUMA 工具
+
+// 一个 NUMA 节点上的线程池和内存池，只被同一节点上的 reactor 和工作线程使用
+// 未开启 NUMA 拆分时全局只有一个，行为与之前相同
+struct NodeContext {
+    int node = -1;                                            // NUMA 节点编号，-1 表示不区分节点
+    std::unique_ptr<ThreadPool> pool;                         // 该节点的工作线程池
+    std::shared_ptr<MemoryPool<HttpRequest>> requestPool;     // 该节点的请求对象池
+    std::shared_ptr<MemoryPool<HttpResponse>> responsePool;   // 该节点的响应对象池
+    std::shared_ptr<BufferSlab> bufferSlab;                   // 该节点的读缓冲区
+};
+
+// 一个 reactor：独立的监听套接字（SO_REUSEPORT 组成员）和 epoll 实例，运行在一个线程上
+struct Reactor {
+    int cpu = -1;                   // 绑定的 CPU，-1 表示不绑核
+    int listenFd = -1;              // 监听套接字
+    int epollFd = -1;               // epoll 实例
+    NodeContext* context = nullptr; // 所在节点的线程池和内存池
+};
 
 class HttpServer {
 public:
     // 构造函数，初始化服务器端口、最大事件数和数据库引用
-    HttpServer(int port, int max_events, Database& db) 
-        : server_fd(-1), epollfd(-1), port(port), max_events(max_events), db(db) {
-        // 初始化内存池，预分配100个 HttpRequest 和 HttpResponse 对象
-        // 这样可以减少在高并发环境下频繁分配和释放内存带来的开销
-        requestPool = std::make_shared<MemoryPool<HttpRequest>>(100);
-        responsePool = std::make_shared<MemoryPool<HttpResponse>>(100);
-    }
+    // huge_pages: 内存池与读缓冲区是否使用 2MB 大页，以及是否预触碰、锁定内存
+    // affinity: reactor 和工作线程的绑核方式，以及是否按 NUMA 节点拆分线程池和内存池
+    HttpServer(int port, int max_events, Database& db, const HugePageOptions& huge_pages = HugePageOptions(),
+               const AffinityOptions& affinity = AffinityOptions())
+        : port(port), max_events(max_events), db(db), hugePages(huge_pages), affinity(affinity) {}
 
     // 启动服务器，开始监听并处理传入的连接
     void start() {
-        setupServerSocket(); // 设置服务器套接字
-        setupEpoll();        // 设置 epoll 监听
-        ThreadPool pool(16); // 初始化一个包含16个线程的线程池，用于处理高并发请求
-
-        struct epoll_event events[max_events]; // 存储触发事件的数组
+        setupContexts(); // 按 NUMA 节点创建线程池和内存池
+        setupReactors(); // 为每个 reactor 创建监听套接字和 epoll
 
-        while (true) {
-            // 等待事件的发生，-1 表示无限等待
-            int nfds = epoll_wait(epollfd, events, max_events, -1);
-            for (int n = 0; n < nfds; ++n) {
-                if (events[n].data.fd == server_fd) {
-                    // 如果事件来自服务器套接字，表示有新的连接请求，进行接受
-                    acceptConnection();
-                } else {
-                    // 否则，事件来自客户端套接字，将处理连接的任务提交给线程池
-                    pool.enqueue([fd = events[n].data.fd, this]() {
-                        this->handleConnection(fd);
-                    });
-                }
-            }
+        // 0 号 reactor 在当前线程运行，其余各自一个线程
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < reactors.size(); ++i) {
+            threads.emplace_back([this, i]() { runReactor(reactors[i]); });
+        }
+        runReactor(reactors[0]);
+        for (std::thread& t : threads) {
+            t.join();
         }
     }
 
@@ -65,20 +75,146 @@ public:
     }
 
 private:
-    int server_fd;    // 服务器套接字文件描述符
-    int epollfd;      // epoll 实例的文件描述符
     int port;         // 服务器监听的端口号
     int max_events;   // epoll 等待的最大事件数
     Router router;    // 路由器，用于处理不同的 HTTP 请求路径
     Database& db;     // 引用数据库实例
+    HugePageOptions hugePages;  // 内存池的大页配置
+    AffinityOptions affinity;   // 绑核与 NUMA 配置
+
+    // 每个 NUMA 节点一套线程池和内存池（HttpRequest/HttpResponse 对象池、读缓冲区 slab）
+    // 用 unique_ptr 保存，保证 Reactor 中的指针在 vector 扩容后仍然有效
+    std::vector<std::unique_ptr<NodeContext>> contexts;
+    std::vector<Reactor> reactors;
+
+    // 读缓冲区 slab，避免每个连接在栈上或堆上临时分配缓冲区
+    static constexpr size_t kReadBufferSize = 4096;
+    static constexpr size_t kReadBufferCount = 64;
+    static constexpr size_t kDefaultWorkers = 16; // 没有指定工作线程 CPU 时每个节点的线程数
+
+    // 按 NUMA 节点创建线程池和内存池
+    // 开启 numaLocal 且指定了 reactor CPU 时，每个 reactor 所在的节点各一套；否则全局一套
+    void setupContexts() {
+        std::vector<int> nodes;
+        if (affinity.numaLocal && !affinity.reactorCpus.empty()) {
+            std::set<int> distinct;
+            for (int cpu : affinity.reactorCpus) {
+                distinct.insert(numaNodeOfCpu(cpu));
+            }
+            nodes.assign(distinct.begin(), distinct.end());
+        } else {
+            nodes.push_back(-1);
+        }
+
+        for (int node : nodes) {
+            auto context = std::make_unique<NodeContext>();
+            context->node = node;
+
+            // 工作线程只绑定到本节点的 CPU 上
+            std::vector<int> workerCpus;
+            for (int cpu : affinity.workerCpus) {
+                if (node < 0 || numaNodeOfCpu(cpu) == node) workerCpus.push_back(cpu);
+            }
+            size_t threads = workerCpus.empty() ? kDefaultWorkers : workerCpus.size();
+            context->pool = std::make_unique<ThreadPool>(threads, workerCpus);
+
+            // 在绑定到本节点 CPU 的临时线程中创建内存池：
+            // 普通堆内存按首次触碰分配到本节点，大页内存额外用 mbind 指定节点
+            int homeCpu = -1;
+            for (int cpu : affinity.reactorCpus) {
+                if (node >= 0 && numaNodeOfCpu(cpu) == node) { homeCpu = cpu; break; }
+            }
+            HugePageOptions options = hugePages;
+            options.numaNode = node;
+            NodeContext* ctx = context.get();
+            std::thread([ctx, homeCpu, options]() {
+                pinCurrentThread(homeCpu);
+                // 初始化内存池，预分配100个 HttpRequest 和 HttpResponse 对象
+                // 这样可以减少在高并发环境下频繁分配和释放内存带来的开销
+                ctx->requestPool = std::make_shared<MemoryPool<HttpRequest>>(100, 1000, options);
+                ctx->responsePool = std::make_shared<MemoryPool<HttpResponse>>(100, 1000, options);
+                // 每个处理中的连接占用一个读缓冲区，数量与线程池大小相匹配并留有余量
+                ctx->bufferSlab = std::make_shared<BufferSlab>(kReadBufferSize, kReadBufferCount, options);
+            }).join();
+
+            LOG_INFO("Node context %d: %zu workers (%zu pinned)", node, threads, workerCpus.size());
+            contexts.push_back(std::move(context));
+        }
+        if (hugePages.enabled) {
+            LOG_INFO("Memory pools backed by huge pages (prefault=%d, mlock=%d)",
+                     hugePages.prefault, hugePages.lock);
+        }
+    }
+
+    // 找到 CPU 所在节点的 NodeContext，没有拆分节点时返回唯一的一个
+    NodeContext* contextForCpu(int cpu) {
+        int node = numaNodeOfCpu(cpu);
+        for (auto& context : contexts) {
+            if (context->node < 0 || context->node == node) return context.get();
+        }
+        return contexts.front().get();
+    }
+
+    // 创建 reactor：每个 reactor 一个 SO_REUSEPORT 监听套接字，由内核在它们之间分配新连接
+    // 有多个绑核的 reactor 时，安装 cBPF 程序按接收 CPU 选择 reactor，连接始终由处理其 RX 队列的核负责
+    void setupReactors() {
+        size_t count = affinity.reactorCpus.empty() ? 1 : affinity.reactorCpus.size();
+        for (size_t i = 0; i < count; ++i) {
+            Reactor reactor;
+            reactor.cpu = affinity.reactorCpus.empty() ? -1 : affinity.reactorCpus[i];
+            reactor.listenFd = setupServerSocket(reactor.cpu, count > 1);
+            reactor.epollFd = setupEpoll(reactor.listenFd);
+            reactor.context = contextForCpu(reactor.cpu);
+            reactors.push_back(reactor);
+        }
 
-    // 内存池对象，用于管理 HttpRequest 和 HttpResponse 对象的分配和回收
-    std::shared_ptr<MemoryPool<HttpRequest>> requestPool;
-    std::shared_ptr<MemoryPool<HttpResponse>> responsePool;
+        if (count > 1) {
+            // CPU -> reactor 映射：reactor 自己的 CPU 归它自己；其余 CPU 归同一 NUMA 节点上的第一个 reactor
+            long cpuCount = sysconf(_SC_NPROCESSORS_CONF);
+            std::vector<int> cpuToReactor(cpuCount > 0 ? cpuCount : 1, 0);
+            for (int cpu = 0; cpu < static_cast<int>(cpuToReactor.size()); ++cpu) {
+                int node = numaNodeOfCpu(cpu);
+                int chosen = -1;
+                for (size_t i = 0; i < count; ++i) {
+                    if (reactors[i].cpu == cpu) { chosen = static_cast<int>(i); break; }
+                    if (chosen < 0 && numaNodeOfCpu(reactors[i].cpu) == node) chosen = static_cast<int>(i);
+                }
+                cpuToReactor[cpu] = chosen < 0 ? cpu % static_cast<int>(count) : chosen;
+            }
+            if (!attachIncomingCpuSteering(reactors[0].listenFd, cpuToReactor)) {
+                LOG_WARNING("SO_ATTACH_REUSEPORT_CBPF failed, falling back to kernel hash distribution");
+            }
+        }
+        LOG_INFO("Started %zu reactor(s) across %zu node context(s)", reactors.size(), contexts.size());
+    }
+
+    // reactor 主循环：接受新连接，把可读的连接交给本节点的线程池
+    void runReactor(Reactor& reactor) {
+        pinCurrentThread(reactor.cpu);
+        std::vector<struct epoll_event> events(max_events); // 存储触发事件的数组
+        NodeContext* context = reactor.context;
+
+        while (true) {
+            // 等待事件的发生，-1 表示无限等待
+            int nfds = epoll_wait(reactor.epollFd, events.data(), max_events, -1);
+            for (int n = 0; n < nfds; ++n) {
+                if (events[n].data.fd == reactor.listenFd) {
+                    // 如果事件来自服务器套接字，表示有新的连接请求，进行接受
+                    acceptConnection(reactor);
+                } else {
+                    // 否则，事件来自客户端套接字，将处理连接的任务提交给本节点的线程池
+                    context->pool->enqueue([fd = events[n].data.fd, context, this]() {
+                        this->handleConnection(fd, *context);
+                    });
+                }
+            }
+        }
+    }
 
     // 设置服务器套接字，包括创建、绑定和监听
-    void setupServerSocket() {
-        server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    // cpu >= 0 时设置 SO_INCOMING_CPU；reusePort 为 true 时加入 SO_REUSEPORT 组
+    int setupServerSocket(int cpu, bool reusePort) {
+        int server_fd = socket(AF_INET, SOCK_STREAM, 0);
         struct sockaddr_in address = {};
         address.sin_family = AF_INET;               // 使用 IPv4
         address.sin_addr.s_addr = INADDR_ANY;       // 绑定到所有可用的接口
@@ -87,6 +223,13 @@ private:
         // 设置套接字选项，允许重用地址和端口
         int opt = 1;
         setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        if (reusePort) {
+            setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+        }
+        if (cpu >= 0) {
+            // 标记该监听套接字属于哪个 CPU，没有安装 cBPF 程序的内核也会优先选择 CPU 匹配的套接字
+            setsockopt(server_fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu));
+        }
 
         // 绑定套接字到指定的地址和端口
         bind(server_fd, (struct sockaddr *)&address, sizeof(address));
@@ -95,30 +238,32 @@ private:
 
         // 将套接字设置为非阻塞模式，以支持高并发
         setNonBlocking(server_fd);
+        return server_fd;
     }
 
     // 设置 epoll，用于高效地监控多个文件描述符的事件
-    void setupEpoll() {
+    int setupEpoll(int server_fd) {
         // 创建一个 epoll 实例
-        epollfd = epoll_create1(0);
+        int epollfd = epoll_create1(0);
         struct epoll_event event = {};
         event.events = EPOLLIN | EPOLLET; // 监听可读事件，并使用边缘触发模式
         event.data.fd = server_fd;        // 将服务器套接字添加到 epoll 监控中
         epoll_ctl(epollfd, EPOLL_CTL_ADD, server_fd, &event);
+        return epollfd;
     }
 
     // 接受一个新的客户端连接，并将其添加到 epoll 监控中
-    void acceptConnection() {
+    void acceptConnection(Reactor& reactor) {
         struct sockaddr_in client_addr;
         socklen_t client_addrlen = sizeof(client_addr);
         int client_sock;
         // 使用循环接受所有待处理的连接请求
-        while ((client_sock = accept(server_fd, (struct sockaddr *)&client_addr, &client_addrlen)) > 0) {
+        while ((client_sock = accept(reactor.listenFd, (struct sockaddr *)&client_addr, &client_addrlen)) > 0) {
             setNonBlocking(client_sock); // 将客户端套接字设置为非阻塞模式
             struct epoll_event event = {};
             event.events = EPOLLIN | EPOLLET; // 监听可读事件，并使用边缘触发模式
             event.data.fd = client_sock;      // 将客户端套接字添加到 epoll 监控中
-            epoll_ctl(epollfd, EPOLL_CTL_ADD, client_sock, &event);
+            epoll_ctl(reactor.epollFd, EPOLL_CTL_ADD, client_sock, &event);
         }
         // 如果接受连接时出错，且错误不是因为资源暂时不可用，记录错误日志
         if (client_sock == -1 && (errno != EAGAIN && errno != EWOULDBLOCK)) {
@@ -127,17 +272,20 @@ private:
     }
 
     // 处理一个客户端连接，包括读取请求、解析、生成响应和发送
-    void handleConnection(int fd) {
-        char buffer[4096];      // 读取数据的缓冲区
+    // 只使用本节点的内存池，对象和缓冲区都在本节点的内存上
+    void handleConnection(int fd, NodeContext& context) {
+        char localBuffer[kReadBufferSize]; // slab 用尽时的后备缓冲区
+        char* slabBuffer = context.bufferSlab->acquire();
+        char* buffer = slabBuffer ? slabBuffer : localBuffer; // 读取数据的缓冲区
         ssize_t bytes_read;     // 实际读取的字节数
         
         // 从请求内存池获取一个 HttpRequest 对象
-        auto request = requestPool->acquire();
+        auto request = context.requestPool->acquire();
         // 从响应内存池获取一个 HttpResponse 对象
-        auto response = responsePool->acquire();
+        auto response = context.responsePool->acquire();
 
         // 循环读取客户端发送的数据
-        while ((bytes_read = read(fd, buffer, sizeof(buffer)-1)) > 0) {
+        while ((bytes_read = read(fd, buffer, kReadBufferSize - 1)) > 0) {
             buffer[bytes_read] = '\0'; // 确保字符串以 null 结尾
             
             // 解析 HTTP 请求
@@ -159,6 +307,10 @@ private:
         if (bytes_read == -1 && errno != EAGAIN) {
             LOG_ERROR("Error reading from socket %d", fd);
         }
+        // 归还读缓冲区
+        if (slabBuffer) {
+            context.bufferSlab->release(slabBuffer);
+        }
         // 关闭客户端套接字，结束连接
         close(fd);
     }
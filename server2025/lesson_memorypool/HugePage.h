@@ -0,0 +1,137 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <stdexcept>
+#include "CpuAffinity.h"
+
+// 大页内存配置：对象池、缓冲区 slab 都可以通过它改为 2MB 大页支撑
+// 大量 keep-alive 连接各自持有缓冲区时，4KB 小页会带来明显的 TLB miss
+struct HugePageOptions {
+    bool enabled = false;   // 是否使用 2MB 大页（MAP_HUGETLB，失败则回退到 madvise 透明大页）
+    bool prefault = false;  // 启动时预先触碰所有页面，消除上线后首次访问的缺页延迟
+    bool lock = false;      // 使用 mlock 锁定内存，防止被换出
+    int numaNode = -1;      // 物理内存优先从该 NUMA 节点分配，-1 表示不指定（由首次触碰的线程决定）
+};
+
+// HugePageRegion 表示一段通过 mmap 申请的连续内存
+// 优先使用 MAP_HUGETLB 申请显式大页；系统没有预留大页时回退为普通 mmap + MADV_HUGEPAGE
+class HugePageRegion {
+public:
+    static constexpr size_t kHugePageSize = 2 * 1024 * 1024; // 2MB 大页
+    static constexpr size_t kPageSize = 4096;                // 普通页大小，用于预触碰
+
+    HugePageRegion(size_t bytes, const HugePageOptions& options)
+        : data_(nullptr), size_(roundUp(bytes)), hugetlb_(false) {
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+        // 1. 尝试显式大页（需要 /proc/sys/vm/nr_hugepages 预留），预触碰时让内核在 mmap 时就建立页表
+        //    指定了 NUMA 节点时不能 MAP_POPULATE，要先 mbind 再触碰，页面才会落在目标节点上
+        bool populate = options.prefault && options.numaNode < 0;
+        int hugeFlags = flags | MAP_HUGETLB | (populate ? MAP_POPULATE : 0);
+        void* p = mmap(nullptr, size_, PROT_READ | PROT_WRITE, hugeFlags, -1, 0);
+        if (p != MAP_FAILED) {
+            hugetlb_ = true;
+        } else {
+            // 2. 回退：普通匿名映射 + 透明大页建议（先 madvise 再触碰，缺页时才会分配大页）
+            p = mmap(nullptr, size_, PROT_READ | PROT_WRITE, flags, -1, 0);
+            if (p == MAP_FAILED) {
+                throw std::runtime_error("HugePageRegion: mmap failed");
+            }
+            madvise(p, size_, MADV_HUGEPAGE);
+        }
+        data_ = static_cast<char*>(p);
+        bindMemoryToNode(data_, size_, options.numaNode);
+
+        // 透明大页路径没有 MAP_POPULATE，这里逐页写一次，确保真正分配物理内存
+        if (options.prefault && !(hugetlb_ && populate)) {
+            for (size_t off = 0; off < size_; off += kPageSize) {
+                data_[off] = 0;
+            }
+        }
+        if (options.lock) {
+            mlock(data_, size_); // 失败（RLIMIT_MEMLOCK 不足）时保持未锁定状态继续运行
+        }
+    }
+
+    ~HugePageRegion() {
+        if (data_) {
+            munmap(data_, size_);
+        }
+    }
+
+    HugePageRegion(const HugePageRegion&) = delete;
+    HugePageRegion& operator=(const HugePageRegion&) = delete;
+
+    char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool isHugeTlb() const { return hugetlb_; } // 是否拿到了显式大页
+
+private:
+    char* data_;
+    size_t size_;
+    bool hugetlb_;
+
+    // 将申请大小向上取整到 2MB 的整数倍
+    static size_t roundUp(size_t bytes) {
+        if (bytes == 0) bytes = 1;
+        return (bytes + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+    }
+};
+
+// BufferSlab 管理一批固定大小的缓冲区（例如每个连接的读缓冲区）
+// 所有缓冲区切分自同一段大页内存，获取/归还只是空闲链表的 push/pop
+class BufferSlab {
+public:
+    // buffer_size: 每个缓冲区的字节数；count: 缓冲区个数
+    BufferSlab(size_t buffer_size, size_t count, const HugePageOptions& options)
+        : bufferSize_(alignUp(buffer_size)),
+          region_(options.enabled ? std::make_unique<HugePageRegion>(bufferSize_ * count, options) : nullptr) {
+        freeList_.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            // 未启用大页时退化为普通堆内存，行为保持一致
+            char* buf = region_ ? region_->data() + i * bufferSize_ : new char[bufferSize_];
+            freeList_.push_back(buf);
+        }
+    }
+
+    ~BufferSlab() {
+        if (!region_) {
+            for (char* buf : freeList_) delete[] buf;
+        }
+    }
+
+    BufferSlab(const BufferSlab&) = delete;
+    BufferSlab& operator=(const BufferSlab&) = delete;
+
+    // 获取一个缓冲区，slab 用尽时返回 nullptr，由调用者决定回退方式
+    char* acquire() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (freeList_.empty()) return nullptr;
+        char* buf = freeList_.back();
+        freeList_.pop_back();
+        return buf;
+    }
+
+    // 归还缓冲区
+    void release(char* buf) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        freeList_.push_back(buf);
+    }
+
+    size_t bufferSize() const { return bufferSize_; }
+
+private:
+    size_t bufferSize_;
+    std::unique_ptr<HugePageRegion> region_; // 为空表示未启用大页
+    std::vector<char*> freeList_;
+    std::mutex mutex_;
+
+    // 按缓存行对齐，避免相邻缓冲区之间的伪共享
+    static size_t alignUp(size_t n) {
+        return (n + 63) & ~static_cast<size_t>(63);
+    }
+};
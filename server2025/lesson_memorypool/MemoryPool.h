@@ -1,5 +1,7 @@
 #pragma once
 
+#include "HugePage.h"
+
 // MemoryPool 类模板用于对象的池化管理，通过复用已分配的对象，减少内存分配和释放的开销
 template <typename T>
 class MemoryPool {
@@ -7,16 +9,41 @@ public:
     // 构造函数，初始化内存池
     // initial_size: 初始池中对象的数量，默认为 100
     // max_pool_size: 池中允许的最大对象数量，默认为 1000
-    MemoryPool(size_t initial_size = 100, size_t max_pool_size = 1000)
+    // huge_pages: 大页配置，启用后所有对象都构造在一段预先映射的大页内存中
+    MemoryPool(size_t initial_size = 100, size_t max_pool_size = 1000,
+               const HugePageOptions& huge_pages = HugePageOptions())
         : max_size_(max_pool_size),    // 设置最大池大小
           allocated_(0) {               // 已分配对象计数初始化为 0
+        if (huge_pages.enabled) {
+            // 一次性为 max_pool_size 个对象预留槽位，对象通过 placement new 构造在槽位上
+            slotSize_ = (sizeof(T) + alignof(T) - 1) / alignof(T) * alignof(T);
+            region_ = std::make_unique<HugePageRegion>(slotSize_ * max_size_, huge_pages);
+            freeSlots_.reserve(max_size_);
+            for (size_t i = max_size_; i > 0; --i) {
+                freeSlots_.push_back(region_->data() + (i - 1) * slotSize_);
+            }
+        }
         // 根据 initial_size 预先创建 initial_size 个对象，并将它们放入池中
-        for (size_t i = 0; i < initial_size; ++i) {
+        for (size_t i = 0; i < initial_size && i < max_size_; ++i) {
             // 创建一个共享指针，带有自定义删除器，当对象释放时将其返回池中
-            pool_.push_back(std::shared_ptr<T>(new T(), [this](T* ptr) {
+            pool_.push_back(std::shared_ptr<T>(createObject(), [this](T* ptr) {
                 this->release(ptr);  // 当对象不再使用时，将其返回到内存池
             }));
         }
+        // 预创建的对象同样计入已分配数量，保证大页槽位不会超过 max_pool_size
+        allocated_.store(pool_.size(), std::memory_order_relaxed);
+    }
+
+    // 析构时先销毁池中的对象：此时 region_、freeSlots_ 和互斥锁都还有效
+    // 池中对象的删除器会再调用 release，destroying_ 让它直接销毁对象而不是放回池中
+    ~MemoryPool() {
+        std::vector<std::shared_ptr<T>> pooled;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            destroying_ = true;
+            pooled.swap(pool_);
+        }
+        pooled.clear();
     }
 
     // 获取一个对象
@@ -33,11 +60,12 @@ public:
         // 如果池为空，且当前已分配的对象数小于最大池大小，创建一个新对象
         if (allocated_.fetch_add(1, std::memory_order_relaxed) < max_size_) {
             // 创建一个新的对象，并返回一个共享指针，带有自定义删除器
-            auto new_obj = std::shared_ptr<T>(new T(), [this](T* ptr) { this->release(ptr); });
+            auto new_obj = std::shared_ptr<T>(createObject(), [this](T* ptr) { this->release(ptr); });
             return new_obj;
         }
 
-        // 如果池已满，返回空指针
+        // 如果池已满，撤销刚才的计数并返回空指针
+        allocated_.fetch_sub(1, std::memory_order_relaxed);
         return nullptr;  
     }
 
@@ -45,21 +73,51 @@ public:
     // 如果池未满，将对象放回池中；如果池已满，则删除对象并减少已分配对象计数
     void release(T* ptr) {
         std::lock_guard<std::mutex> lock(mutex_);  // 加锁，确保线程安全
-        // 如果池中空间未满，添加对象到池中
-        if (pool_.size() < max_size_) {
+        // 如果池中空间未满，添加对象到池中（池正在析构时不再放回）
+        if (!destroying_ && pool_.size() < max_size_) {
             pool_.push_back(std::shared_ptr<T>(ptr, [this](T* p) {
                 this->release(p);  // 当对象不再使用时，将其归还池中
             }));
         } else {
             // 如果池已满，删除该对象并减少已分配对象计数
-            delete ptr;
+            destroyObject(ptr);
             allocated_.fetch_sub(1, std::memory_order_relaxed);
         }
     }
 
+    // 对象是否构造在大页内存上
+    bool usesHugePages() const { return region_ != nullptr; }
+
 private:
     std::vector<std::shared_ptr<T>> pool_;  // 用于存储池中的对象，采用共享指针管理对象生命周期
     std::mutex mutex_;                     // 互斥锁，确保多线程环境下对池的访问是线程安全的
     const size_t max_size_;                // 池中允许的最大对象数量
     std::atomic<size_t> allocated_;        // 已分配对象的数量，原子操作以确保并发环境下的安全
+    bool destroying_ = false;              // 析构中，归还的对象直接销毁（由 mutex_ 保护）
+
+    std::unique_ptr<HugePageRegion> region_; // 大页内存区域，为空表示使用普通 new/delete
+    std::vector<char*> freeSlots_;           // 大页区域中尚未使用的对象槽位
+    size_t slotSize_ = 0;                    // 每个对象槽位的大小（按 alignof(T) 对齐）
+
+    // 创建一个新对象：启用大页时在空闲槽位上构造，否则直接 new
+    T* createObject() {
+        if (!region_) return new T();
+        std::lock_guard<std::mutex> lock(slotMutex_);
+        char* slot = freeSlots_.back();
+        freeSlots_.pop_back();
+        return new (slot) T();
+    }
+
+    // 销毁对象：启用大页时析构后把槽位放回空闲列表，否则直接 delete
+    void destroyObject(T* ptr) {
+        if (!region_) {
+            delete ptr;
+            return;
+        }
+        ptr->~T();
+        std::lock_guard<std::mutex> lock(slotMutex_);
+        freeSlots_.push_back(reinterpret_cast<char*>(ptr));
+    }
+
+    std::mutex slotMutex_; // 保护 freeSlots_，release 时已持有 mutex_，因此使用独立的锁
 };
@@ -5,12 +5,16 @@
 #include <condition_variable>
 #include <functional>
 #include <future>
+#include "CpuAffinity.h"
 
 class ThreadPool {
 public:
-    ThreadPool(size_t threads) : stop(false) {
+    // cpus 不为空时，第 i 个线程绑定到 cpus[i % cpus.size()]
+    ThreadPool(size_t threads, const std::vector<int>& cpus = std::vector<int>()) : stop(false) {
         for(size_t i = 0; i < threads; ++i) {
-            workers.emplace_back([this] {
+            int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+            workers.emplace_back([this, cpu] {
+                pinCurrentThread(cpu);
                 while(true) {
                     std::function<void()> task;
                     {
@@ -7,8 +7,22 @@ int main(int argc, char* argv[]) {
     if (argc > 1) {
         port = std::stoi(argv[1]); // 从命令行获取端口
     }
+    // 可选参数：--hugepages 使用 2MB 大页，--prefault 启动时预触碰内存，--mlock 锁定内存
+    // 绑核参数：--reactor-cpus=0,1 每个 CPU 一个 reactor，--worker-cpus=2-15 工作线程可用的 CPU，
+    // --numa 按 NUMA 节点拆分线程池和内存池
+    HugePageOptions hugePages;
+    AffinityOptions affinity;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--hugepages") hugePages.enabled = true;
+        else if (arg == "--prefault") hugePages.prefault = true;
+        else if (arg == "--mlock") hugePages.lock = true;
+        else if (arg.rfind("--reactor-cpus=", 0) == 0) affinity.reactorCpus = parseCpuList(arg.substr(15));
+        else if (arg.rfind("--worker-cpus=", 0) == 0) affinity.workerCpus = parseCpuList(arg.substr(14));
+        else if (arg == "--numa") affinity.numaLocal = true;
+    }
     Database db("users.db"); // 初始化数据库
-    HttpServer server(port, 10, db);
+    HttpServer server(port, 10, db, hugePages, affinity);
     server.setupRoutes();
     server.start();
     return 0;
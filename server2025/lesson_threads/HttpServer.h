@@ -6,6 +6,9 @@
 #include <netinet/in.h>
 #include <unistd.h>
 #include <cstring>
+#include <deque>
+#include <algorithm>
+#include <chrono>
 #include "Logger.h"
 #include "ThreadPool.h"
 #include "Router.h"
@@ -13,28 +16,52 @@
 #include "HttpResponse.h"
 #include "Database.h"
 
+// 过载时的处理策略
+enum class OverloadPolicy {
+    Reject503,    // 直接在 epoll 线程回复 503 Service Unavailable + Retry-After
+    PauseReading  // 暂停 accept 和读取，连接留在内核队列中，等线程池回落到低水位再继续
+};
+
+// 准入控制配置
+struct AdmissionOptions {
+    size_t highWatermark = 1024;                     // 排队任务数高水位，达到后开始降级
+    size_t lowWatermark = 768;                       // 低水位，回落到这里以下才恢复
+    OverloadPolicy policy = OverloadPolicy::Reject503;
+    std::chrono::milliseconds queueTimeout{3000};    // 排队超过该时间的请求直接丢弃（客户端多半已放弃）
+    int retryAfterSeconds = 1;                       // 503 响应中 Retry-After 的秒数
+};
+
 class HttpServer {
 public:
-    HttpServer(int port, int max_events, Database& db) 
-        : server_fd(-1), epollfd(-1), port(port), max_events(max_events), db(db) {}
+    HttpServer(int port, int max_events, Database& db, const AdmissionOptions& admission = AdmissionOptions())
+        : server_fd(-1), epollfd(-1), port(port), max_events(max_events), db(db), admission(admission),
+          acceptPaused(false) {}
 
     void start() {
         setupServerSocket();
         setupEpoll();
-        ThreadPool pool(4,16); // 使用大型线程池处理高并发
+        // 4~16 个线程，由线程池根据排队时间自动伸缩
+        pool = std::make_unique<ThreadPool>(4, 16);
+        pool->setQueueLimits(admission.highWatermark, admission.lowWatermark);
 
         struct epoll_event events[max_events];
 
         while (true) {
-            int nfds = epoll_wait(epollfd, events, max_events, -1);
+            // 有被暂停的连接时定期醒来检查线程池是否已经回落
+            bool paused = acceptPaused || !deferred.empty();
+            int nfds = epoll_wait(epollfd, events, max_events, paused ? 10 : -1);
+            if (paused) {
+                resumeDeferred();
+            }
             for (int n = 0; n < nfds; ++n) {
                 if (events[n].data.fd == server_fd) {
-                    acceptConnection();
+                    if (admission.policy == OverloadPolicy::PauseReading && pool->overloaded()) {
+                        acceptPaused = true; // 新连接留在内核的 accept 队列中
+                    } else {
+                        acceptConnection();
+                    }
                 } else {
-                    // 使用线程池异步处理连接
-                    pool.enqueue([fd = events[n].data.fd, this]() {
-                        this->handleConnection(fd);
-                    });
+                    serveInline(events[n].data.fd);
                 }
             }
         }
@@ -46,14 +73,139 @@ public:
             response.setStatusCode(200);
             response.setBody("Hello, World!");
             return response;
-        });
+        }, RouteMode::Inline);
         router.setupDatabaseRoutes(db);
+
+        // 线程池指标：线程数、利用率、p99 排队时间以及扩缩容次数
+        router.addRoute("GET", "/metrics", [this](const HttpRequest&) {
+            ThreadPool::Stats stats = pool->getStats();
+            std::ostringstream oss;
+            oss << "threadpool_workers " << stats.workers << "\n"
+                << "threadpool_utilization " << stats.utilization << "\n"
+                << "threadpool_queue_wait_p99_us " << stats.p99WaitUs << "\n"
+                << "threadpool_tasks_completed " << stats.tasksCompleted << "\n"
+                << "threadpool_scale_ups " << stats.scaleUps << "\n"
+                << "threadpool_scale_downs " << stats.scaleDowns << "\n"
+                << "threadpool_queued " << stats.queued << "\n"
+                << "threadpool_rejected " << stats.rejected << "\n"
+                << "http_shed_503 " << shed503.load() << "\n"
+                << "http_deadline_dropped " << deadlineDropped.load() << "\n"
+                << "http_inline_handled " << inlineHandled.load() << "\n";
+            HttpResponse response;
+            response.setStatusCode(200);
+            response.setHeader("Content-Type", "text/plain");
+            response.setBody(oss.str());
+            return response;
+        }, RouteMode::Inline);
     }
 
 private:
     int server_fd, epollfd, port, max_events;
     Router router;
     Database& db;
+    std::unique_ptr<ThreadPool> pool; // 在 start() 中创建，/metrics 路由读取其指标
+    AdmissionOptions admission;
+    std::deque<int> deferred;         // PauseReading 策略下暂缓处理的连接（边缘触发，必须自己记住）
+    bool acceptPaused;                // 是否有待 accept 的连接被暂缓
+    std::atomic<uint64_t> shed503{0};          // 过载时直接回复 503 的请求数
+    std::atomic<uint64_t> deadlineDropped{0};  // 排队超时被丢弃的请求数
+    std::atomic<uint64_t> inlineHandled{0};    // 在 epoll 线程上直接处理的请求数
+
+    // 可读事件的快速路径：先用 MSG_PEEK 看一眼请求行，Inline 路由直接在 epoll 线程上处理，
+    // 其余请求原样交给线程池（数据仍在内核缓冲区中，工作线程照常读取）
+    // 连接以 EPOLLONESHOT 注册：一次事件之后不会再有事件，连接只属于当前处理者（epoll 线程、
+    // 工作线程或暂缓队列之一），只有它会关闭 fd，不会出现关闭了另一个线程正在使用的 fd
+    void serveInline(int fd) {
+        bool served = false;
+        while (true) {
+            char peek[512];
+            ssize_t n = recv(fd, peek, sizeof(peek), MSG_PEEK);
+            if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                if (served) {
+                    close(fd); // 响应以关闭连接结束，与 handleConnection 一致
+                } else {
+                    rearm(fd); // 还没有数据（虚假唤醒），重新等待可读
+                }
+                return;
+            }
+            if (n <= 0) {
+                close(fd); // 对端关闭或读取出错
+                return;
+            }
+            if (!peekIsInline(peek, static_cast<size_t>(n))) {
+                dispatch(fd);
+                return;
+            }
+            char buffer[4096];
+            ssize_t bytes_read = read(fd, buffer, sizeof(buffer) - 1);
+            if (bytes_read <= 0) {
+                close(fd);
+                return;
+            }
+            buffer[bytes_read] = '\0';
+            processRequest(fd, buffer);
+            served = true;
+            inlineHandled.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // 从请求行（"GET /path HTTP/1.1"）中取出方法和路径，判断是否为 Inline 路由
+    bool peekIsInline(const char* data, size_t len) const {
+        const char* end = data + len;
+        const char* sp1 = std::find(data, end, ' ');
+        if (sp1 == end) return false;
+        const char* sp2 = std::find(sp1 + 1, end, ' ');
+        if (sp2 == end) return false; // 请求行不完整，交给线程池按原逻辑处理
+        return router.isInline(std::string(data, sp1), std::string(sp1 + 1, sp2));
+    }
+
+    // 把可读的连接交给线程池；队列已满时按策略降级
+    void dispatch(int fd) {
+        auto queuedAt = std::chrono::steady_clock::now();
+        // 使用线程池异步处理连接，不需要结果；lambda 很小，提交时不分配内存
+        bool accepted = pool->tryPost([fd, this, queuedAt]() {
+            // 排队太久，客户端多半已经超时放弃，不再浪费时间处理
+            if (std::chrono::steady_clock::now() - queuedAt > admission.queueTimeout) {
+                deadlineDropped.fetch_add(1, std::memory_order_relaxed);
+                close(fd);
+                return;
+            }
+            this->handleConnection(fd);
+        });
+        if (accepted) return;
+        if (admission.policy == OverloadPolicy::Reject503) {
+            rejectOverloaded(fd);
+        } else {
+            deferred.push_back(fd);
+        }
+    }
+
+    // 线程池回落到低水位后，继续处理暂缓的连接和 accept 队列
+    void resumeDeferred() {
+        while (!deferred.empty() && !pool->overloaded()) {
+            int fd = deferred.front();
+            deferred.pop_front();
+            dispatch(fd);
+        }
+        if (acceptPaused && !pool->overloaded()) {
+            acceptPaused = false;
+            acceptConnection();
+        }
+    }
+
+    // 在 epoll 线程直接回复 503，不经过线程池
+    void rejectOverloaded(int fd) {
+        // 先读掉请求，避免关闭时内核因未读数据发送 RST 导致客户端收不到响应
+        char buffer[4096];
+        while (read(fd, buffer, sizeof(buffer)) > 0) {}
+        std::string response = "HTTP/1.1 503 Service Unavailable\r\n"
+                               "Retry-After: " + std::to_string(admission.retryAfterSeconds) + "\r\n"
+                               "Content-Length: 0\r\n"
+                               "Connection: close\r\n\r\n";
+        send(fd, response.c_str(), response.length(), MSG_NOSIGNAL);
+        close(fd);
+        shed503.fetch_add(1, std::memory_order_relaxed);
+    }
 
     void setupServerSocket() {
         server_fd = socket(AF_INET, SOCK_STREAM, 0);
@@ -86,7 +238,7 @@ private:
         while ((client_sock = accept(server_fd, (struct sockaddr *)&client_addr, &client_addrlen)) > 0) {
             setNonBlocking(client_sock);
             struct epoll_event event = {};
-            event.events = EPOLLIN | EPOLLET;
+            event.events = EPOLLIN | EPOLLET | EPOLLONESHOT; // 每次事件只交给一个处理者
             event.data.fd = client_sock;
             epoll_ctl(epollfd, EPOLL_CTL_ADD, client_sock, &event);
         }
@@ -111,16 +263,7 @@ private:
                 break;
             } else {
                 buffer[bytes_read] = '\0'; // 确保字符串结束
-
-                // 处理读取到的数据
-                HttpRequest request;
-                if (request.parse(buffer.data())) {
-                    HttpResponse response = router.routeRequest(request);
-                    std::string response_str = response.toString();
-
-                    // 尝试一次性发送响应
-                    send(fd, response_str.c_str(), response_str.length(), 0);
-                }
+                processRequest(fd, buffer.data());
             }
         }
 
@@ -128,7 +271,27 @@ private:
         close(fd); // 关闭连接
     }
 
+    // 解析一段请求数据，路由并发送响应（线程池和 epoll 线程共用）
+    void processRequest(int fd, const char* data) {
+        HttpRequest request;
+        if (request.parse(data)) {
+            HttpResponse response = router.routeRequest(request);
+            std::string response_str = response.toString();
+
+            // 尝试一次性发送响应
+            send(fd, response_str.c_str(), response_str.length(), 0);
+        }
+    }
+
+
 
+    // 重新启用一次性事件：连接交还给 epoll
+    void rearm(int fd) {
+        struct epoll_event event = {};
+        event.events = EPOLLIN | EPOLLET | EPOLLONESHOT;
+        event.data.fd = fd;
+        epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &event);
+    }
 
     void setNonBlocking(int sock) {
         int flags = fcntl(sock, F_GETFL, 0);
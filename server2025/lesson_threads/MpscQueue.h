@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+
+// 无锁多生产者单消费者（MPSC）侵入式队列（Vyukov 算法）
+// 多个线程（例如 epoll 主线程）可以并发 push，只有拥有者工作线程 pop
+// Node 必须可默认构造，并包含成员 std::atomic<Node*> next
+template <typename Node>
+class MpscQueue {
+public:
+    MpscQueue() : head_(&stub_), tail_(&stub_) {
+        stub_.next.store(nullptr, std::memory_order_relaxed);
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // 任意线程：入队，只有一次原子交换，不会阻塞
+    void push(Node* node) {
+        size_.fetch_add(1, std::memory_order_seq_cst);
+        link(node);
+    }
+
+    // 消费者线程：出队，为空（或生产者尚未完成链接）时返回 nullptr
+    Node* pop() {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &stub_) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next != nullptr) {
+            tail_ = next;
+            return taken(tail);
+        }
+        if (tail != head_.load(std::memory_order_acquire)) {
+            return nullptr; // 有生产者正在入队，稍后再取
+        }
+        link(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            tail_ = next;
+            return taken(tail);
+        }
+        return nullptr;
+    }
+
+    // 任意线程：队列中（包括正在入队的）元素个数的近似值
+    size_t size() const { return size_.load(std::memory_order_seq_cst); }
+    bool empty() const { return size() == 0; }
+
+private:
+    alignas(64) std::atomic<Node*> head_; // 生产者端
+    alignas(64) Node* tail_;              // 消费者端
+    std::atomic<size_t> size_{0};         // 计数，供休眠前判断是否还有任务
+    Node stub_;
+
+    void link(Node* node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    Node* taken(Node* node) {
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        return node;
+    }
+};
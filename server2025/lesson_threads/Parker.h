@@ -0,0 +1,70 @@
+#pragma once
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Parker：基于 futex 的单线程休眠/唤醒令牌
+// 每个工作线程独占一个 Parker，唤醒者把令牌交给指定线程，不存在“唤醒了错误线程”或丢失唤醒的问题
+//   park():   拥有者线程调用；有令牌则立即返回，否则在 futex 上休眠直到拿到令牌
+//   parkFor(): 同 park()，但最多休眠指定时长；返回是否拿到了令牌
+//   unpark(): 任意线程调用；发放令牌，只有对方确实在休眠时才进入内核
+class Parker {
+public:
+    Parker() : token_(0), waiting_(0) {}
+
+    Parker(const Parker&) = delete;
+    Parker& operator=(const Parker&) = delete;
+
+    void park() {
+        while (token_.exchange(0, std::memory_order_acquire) == 0) {
+            waiting_.store(1, std::memory_order_seq_cst);
+            // 再检查一次令牌，避免在设置 waiting_ 之前到达的令牌被错过
+            if (token_.load(std::memory_order_seq_cst) == 0) {
+                futexWait(&token_, 0);
+            }
+            waiting_.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    bool parkFor(std::chrono::nanoseconds timeout) {
+        if (token_.exchange(0, std::memory_order_acquire) != 0) {
+            return true;
+        }
+        waiting_.store(1, std::memory_order_seq_cst);
+        if (token_.load(std::memory_order_seq_cst) == 0) {
+            struct timespec ts;
+            ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+            ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+            futexWait(&token_, 0, &ts);
+        }
+        waiting_.store(0, std::memory_order_relaxed);
+        return token_.exchange(0, std::memory_order_acquire) != 0;
+    }
+
+    void unpark() {
+        if (token_.exchange(1, std::memory_order_seq_cst) == 0 &&
+            waiting_.load(std::memory_order_seq_cst) != 0) {
+            futexWake(&token_);
+        }
+    }
+
+private:
+    std::atomic<uint32_t> token_;   // 1 表示有一个待领取的唤醒令牌（futex 字）
+    std::atomic<uint32_t> waiting_; // 拥有者是否可能正在 futex 上休眠
+
+    static void futexWait(std::atomic<uint32_t>* addr, uint32_t expected,
+                          const struct timespec* timeout = nullptr) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT_PRIVATE, expected,
+                timeout, nullptr, 0);
+    }
+
+    static void futexWake(std::atomic<uint32_t>* addr) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE_PRIVATE, 1,
+                nullptr, nullptr, 0);
+    }
+};
@@ -2,6 +2,13 @@
 #include "HttpResponse.h"
 #include "Database.h"
 
+// 路由的执行方式
+enum class RouteMode {
+    Pool,   // 默认：交给线程池执行
+    Inline  // 直接在 epoll 线程上执行（解析、处理、发送都不换线程）
+            // 只适用于不阻塞、耗时很短的处理函数，例如固定文本、内存中的数据
+};
+
 // Router 类负责将特定的 HTTP 请求映射到相应的处理函数
 class Router {
 public:
@@ -9,20 +16,27 @@ public:
     using HandlerFunc = std::function<HttpResponse(const HttpRequest&)>;
 
     // 添加路由：将 HTTP 方法和路径映射到处理函数
-    void addRoute(const std::string& method, const std::string& path, HandlerFunc handler) {
-        routes[method + "|" + path] = handler;
+    void addRoute(const std::string& method, const std::string& path, HandlerFunc handler,
+                  RouteMode mode = RouteMode::Pool) {
+        routes[method + "|" + path] = Route{std::move(handler), mode};
     }
 
     // 根据 HTTP 请求路由到相应的处理函数
-    HttpResponse routeRequest(const HttpRequest& request) {
-        std::string key = request.getMethodString() + "|" + request.getPath();
-        if (routes.count(key)) {
-            return routes[key](request);
+    HttpResponse routeRequest(const HttpRequest& request) const {
+        auto it = routes.find(request.getMethodString() + "|" + request.getPath());
+        if (it != routes.end()) {
+            return it->second.handler(request);
         }
         // 如果没有找到匹配的路由，返回 404 Not Found 响应
         return HttpResponse::makeErrorResponse(404, "Not Found");
     }
 
+    // 该方法和路径是否注册为可以在 epoll 线程上直接执行的路由
+    bool isInline(const std::string& method, const std::string& path) const {
+        auto it = routes.find(method + "|" + path);
+        return it != routes.end() && it->second.mode == RouteMode::Inline;
+    }
+
 
     std::string readFile(const std::string& filePath) {
         // 使用标准库中的ifstream打开文件
@@ -126,5 +140,9 @@ public:
     }
 
 private:
-    std::unordered_map<std::string, HandlerFunc> routes;  // 存储路由映射
+    struct Route {
+        HandlerFunc handler;
+        RouteMode mode;
+    };
+    std::unordered_map<std::string, Route> routes;  // 存储路由映射
 };
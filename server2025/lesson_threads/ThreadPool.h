@@ -1,29 +1,71 @@
 // 引入必要的头文件
-#include <vector> // 使用vector来存储工作线程和本地任务队列
-#include <deque> // 使用deque作为任务队列，支持从两端操作
+#include <vector> // 使用vector来存储工作线程
 #include <thread> // 使用thread来创建和管理线程
-#include <mutex> // 使用mutex来保护共享资源，防止数据竞争
-#include <condition_variable> // 使用condition_variable来同步线程，实现等待唤醒机制
-#include <functional> // 使用functional来处理任务函数
+#include <mutex> // 使用mutex保护节点池扩容
+#include <functional> // 使用functional来计算线程随机数种子
 #include <future> // 使用future来获取异步操作的结果
 #include <atomic> // 使用atomic来实现原子操作，保证操作的原子性
-#include <chrono> // 使用chrono来处理时间
-#include <random> // 使用random来实现随机数生成，用于任务窃取算法
+#include <memory> // 使用unique_ptr管理工作线程结构
+#include <stdexcept> // 使用runtime_error报告非法参数
+#include <chrono> // 使用chrono测量任务排队时间和线程忙碌时间
+#include "WorkStealingDeque.h" // Chase-Lev 无锁工作窃取队列
+#include "MpscQueue.h" // 无锁多生产者单消费者收件箱
+#include "UniqueFunction.h" // 带内联存储的只可移动任务类型
+#include "Parker.h" // 基于 futex 的每线程唤醒令牌
+
+// 自动伸缩参数
+struct AutoscaleOptions {
+    std::chrono::microseconds targetWait{2000}; // p99 排队时间目标，超过即扩容
+    std::chrono::milliseconds evaluateInterval{100}; // 周期性评估间隔（用于缩容和更新利用率）
+    std::chrono::milliseconds scaleUpCooldown{10}; // 两次扩容之间的最小间隔
+    std::chrono::milliseconds retireAfter{2000}; // 持续空闲多久后回收一个线程
+    double idleUtilization = 0.25; // 利用率低于该值视为空闲
+    double ewmaAlpha = 0.3; // 利用率 EWMA 平滑系数
+};
 
 // 定义线程池类
+// 每个工作线程拥有：
+//   1) 一个 Chase-Lev 双端队列：自己在底部 push/pop，其他线程从顶部 CAS 窃取
+//   2) 一个 MPSC 收件箱：外部线程（epoll 主线程）提交的任务先进入这里，不需要加锁
+// 空闲线程随机选择窃取对象，不再加锁扫描所有队列
+// 任务节点来自线程池内部的无锁节点池，post() 提交小型 lambda 时不会发生任何堆分配
+// 空闲线程先自旋一小段时间再通过 futex 休眠；投递任务时优先交给正在自旋的线程，
+// 只有没有自旋线程时才唤醒一个指定的休眠线程，稳定负载下几乎不产生系统调用
+// 线程数由自动伸缩线程根据任务排队时间（p99）和线程利用率（EWMA）调整：
+// 有任务排队超过目标时间时立即被唤醒扩容；利用率持续偏低时通过“退出令牌”让指定线程退出
 class ThreadPool {
 public:
+    // 线程池指标，反映自动伸缩的决策
+    struct Stats {
+        size_t workers;           // 当前线程数
+        double utilization;       // 线程利用率（EWMA，0~1）
+        uint64_t p99WaitUs;       // 最近一个评估窗口的 p99 排队时间（微秒）
+        uint64_t tasksCompleted;  // 累计完成的任务数
+        uint64_t scaleUps;        // 累计扩容次数
+        uint64_t scaleDowns;      // 累计缩容次数
+        size_t queued;            // 当前排队（已提交未开始执行）的任务数
+        uint64_t rejected;        // 因队列已满被 tryPost 拒绝的任务数
+    };
+
     // 构造函数，初始化线程池的最小和最大线程数
-    ThreadPool(size_t minThreads, size_t maxThreads)
-        : stop(false), minThreads(minThreads), maxThreads(maxThreads), activeThreads(0) {
-        // 预分配本地任务队列和互斥锁
-        localTasks.resize(maxThreads);
-        localMutexes.resize(maxThreads);
+    // 工作线程结构按 maxThreads 预先分配，窃取者遍历时数组不会被重新分配
+    // 线程状态用 64 位掩码记录，因此 maxThreads 不能超过 64
+    ThreadPool(size_t minThreads, size_t maxThreads, const AutoscaleOptions& options = AutoscaleOptions())
+        : stop(false), minThreads(minThreads), maxThreads(maxThreads), workerCount(0),
+          parkedMask(0), spinningMask(0), options(options),
+          autoscaling(maxThreads > minThreads), scaleSignal(false) {
+        if (minThreads == 0 || minThreads > maxThreads || maxThreads > 64) {
+            throw std::runtime_error("ThreadPool: invalid thread count");
+        }
         for (size_t i = 0; i < maxThreads; ++i) {
-            localMutexes[i] = std::make_unique<std::mutex>();
+            workers.push_back(std::make_unique<Worker>());
         }
         // 启动初始工作线程
         addWorkers(minThreads);
+        // 启动自动伸缩线程（之后只有它会增减工作线程）
+        if (autoscaling) {
+            scaler = std::thread(&ThreadPool::autoscaleLoop, this);
+        }
     }
 
     // 析构函数，负责清理资源，停止所有工作线程
@@ -31,177 +73,607 @@ public:
         stopPool();
     }
 
-    // 提交任务到线程池
+    // 获取线程池指标
+    Stats getStats() const {
+        Stats stats;
+        stats.workers = workerCount.load(std::memory_order_relaxed);
+        stats.utilization = utilizationEwma.load(std::memory_order_relaxed);
+        stats.p99WaitUs = p99WaitUs.load(std::memory_order_relaxed);
+        stats.tasksCompleted = 0;
+        for (size_t i = 0; i < maxThreads; ++i) {
+            stats.tasksCompleted += workers[i]->completed.load(std::memory_order_relaxed);
+        }
+        stats.scaleUps = scaleUps.load(std::memory_order_relaxed);
+        stats.scaleDowns = scaleDowns.load(std::memory_order_relaxed);
+        stats.queued = queuedTasks.load(std::memory_order_relaxed);
+        stats.rejected = rejectedTasks.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    // 设置排队任务数的高低水位：达到高水位后 tryPost 开始拒绝，直到降到低水位以下才恢复接收
+    // highWatermark 为 0 表示不限制（默认）
+    void setQueueLimits(size_t highWatermark, size_t lowWatermark) {
+        queueHigh.store(highWatermark, std::memory_order_relaxed);
+        queueLow.store(lowWatermark < highWatermark ? lowWatermark : highWatermark, std::memory_order_relaxed);
+    }
+
+    // 是否处于过载状态（排队任务数超过高水位且尚未回落到低水位）
+    bool overloaded() const {
+        if (!overloadedFlag.load(std::memory_order_relaxed)) return false;
+        return queuedTasks.load(std::memory_order_relaxed) > queueLow.load(std::memory_order_relaxed);
+    }
+
+    // 提交任务到线程池，返回 future 供需要结果的调用者使用
     template<typename F, typename... Args>
     auto enqueue(F&& f, Args&&... args)
         -> std::future<typename std::result_of<F(Args...)>::type> {
         using return_type = typename std::result_of<F(Args...)>::type;
-        // 创建任务包装对象
-        auto task = std::make_shared<std::packaged_task<return_type()>>(
+        if (stop) throw std::runtime_error("enqueue on stopped ThreadPool");
+        // packaged_task 只可移动，直接放进 UniqueFunction，不再需要 shared_ptr 包装
+        std::packaged_task<return_type()> task(
             std::bind(std::forward<F>(f), std::forward<Args>(args)...)
         );
         // 获取任务的future对象
-        std::future<return_type> res = task->get_future();
-        // 分配任务到最少负载的线程
-        size_t leastLoadedThread = selectLeastLoadedThread();
-        {
-            std::lock_guard<std::mutex> lock(*localMutexes[leastLoadedThread]);
-            localTasks[leastLoadedThread].emplace_back([task]() { (*task)(); });
-        }
-        // 通知一个可能在等待的线程
-        condition.notify_one();
-        // 动态调整线程池大小
-        adjustThreadPoolSize();
+        std::future<return_type> res = task.get_future();
+        submit(makeNode([task = std::move(task)]() mutable { task(); }));
         return res;
     }
 
+    // 提交一个不关心结果的任务（fire-and-forget）
+    // 捕获不超过 UniqueFunction::kInlineSize 字节的 lambda 直接构造在复用的任务节点中，不分配内存
+    template<typename F>
+    void post(F&& f) {
+        if (stop) throw std::runtime_error("post on stopped ThreadPool");
+        submit(makeNode(std::forward<F>(f)));
+    }
+
+    // 带准入控制的 post：排队任务数达到高水位时不入队并返回 false，由调用者决定如何降级
+    // （例如直接回复 503，或暂停读取套接字）
+    template<typename F>
+    bool tryPost(F&& f) {
+        if (stop) throw std::runtime_error("tryPost on stopped ThreadPool");
+        size_t high = queueHigh.load(std::memory_order_relaxed);
+        if (high != 0) {
+            size_t queued = queuedTasks.load(std::memory_order_relaxed);
+            if (overloadedFlag.load(std::memory_order_relaxed)) {
+                // 过载后需要回落到低水位才恢复，避免在高水位附近来回抖动
+                if (queued > queueLow.load(std::memory_order_relaxed)) {
+                    rejectedTasks.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                overloadedFlag.store(false, std::memory_order_relaxed);
+            } else if (queued >= high) {
+                overloadedFlag.store(true, std::memory_order_relaxed);
+                rejectedTasks.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        submit(makeNode(std::forward<F>(f)));
+        return true;
+    }
+
 private:
+    // 任务节点：既能放进 Chase-Lev 队列（按指针），也能挂进 MPSC 收件箱（侵入式 next）
+    struct TaskNode {
+        UniqueFunction<void()> fn;
+        std::atomic<TaskNode*> next{nullptr};
+        std::atomic<uint32_t> freeNext{0}; // 空闲链表中下一个节点的编号
+        uint32_t index = 0;                // 节点在节点池中的编号
+        uint64_t enqueueNs = 0;            // 入队时间，用于统计排队时间
+    };
+
+    // 任务节点池：节点按块预分配，空闲节点组成无锁栈（Treiber 栈）
+    // 栈顶用“版本号 << 32 | 节点编号”表示，避免 ABA 问题；节点一经分配永不释放，直到线程池析构
+    class NodePool {
+    public:
+        static constexpr uint32_t kNil = 0xffffffffu;
+        static constexpr size_t kChunkSize = 1024;
+        static constexpr size_t kMaxChunks = 1024; // 最多约 100 万个同时在途的任务节点
+
+        NodePool() : head_(kNil), chunkCount_(0) {
+            for (auto& chunk : chunks_) chunk.store(nullptr, std::memory_order_relaxed);
+        }
+
+        ~NodePool() {
+            for (auto& chunk : chunks_) delete[] chunk.load(std::memory_order_relaxed);
+        }
+
+        // 取出一个空闲节点，空闲链表为空时分配新的一块
+        TaskNode* acquire() {
+            uint64_t head = head_.load(std::memory_order_acquire);
+            while (true) {
+                uint32_t idx = static_cast<uint32_t>(head);
+                if (idx == kNil) return grow();
+                TaskNode* node = nodeAt(idx);
+                uint64_t next = ((head >> 32) + 1) << 32 | node->freeNext.load(std::memory_order_relaxed);
+                if (head_.compare_exchange_weak(head, next, std::memory_order_acq_rel,
+                                                std::memory_order_acquire)) {
+                    return node;
+                }
+            }
+        }
+
+        // 归还节点（任意线程）
+        void release(TaskNode* node) {
+            uint64_t head = head_.load(std::memory_order_relaxed);
+            uint64_t next;
+            do {
+                node->freeNext.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+                next = ((head >> 32) + 1) << 32 | node->index;
+            } while (!head_.compare_exchange_weak(head, next, std::memory_order_release,
+                                                  std::memory_order_relaxed));
+        }
+
+    private:
+        std::atomic<uint64_t> head_;
+        std::atomic<TaskNode*> chunks_[kMaxChunks];
+        size_t chunkCount_; // 受 growMutex_ 保护
+        std::mutex growMutex_;
+
+        TaskNode* nodeAt(uint32_t idx) const {
+            return &chunks_[idx / kChunkSize].load(std::memory_order_acquire)[idx % kChunkSize];
+        }
+
+        // 分配新的一块节点：第一个直接返回，其余放入空闲链表（只在启动或突发流量时发生）
+        TaskNode* grow() {
+            std::lock_guard<std::mutex> lock(growMutex_);
+            if (chunkCount_ == kMaxChunks) {
+                throw std::runtime_error("ThreadPool: too many tasks in flight");
+            }
+            size_t c = chunkCount_++;
+            TaskNode* chunk = new TaskNode[kChunkSize];
+            for (size_t i = 0; i < kChunkSize; ++i) {
+                chunk[i].index = static_cast<uint32_t>(c * kChunkSize + i);
+            }
+            chunks_[c].store(chunk, std::memory_order_release);
+            for (size_t i = 1; i < kChunkSize; ++i) {
+                release(&chunk[i]);
+            }
+            return &chunk[0];
+        }
+    };
+
+    // 每个工作线程的私有结构
+    struct Worker {
+        std::thread th;
+        WorkStealingDeque<TaskNode*> deque; // 本地任务队列
+        MpscQueue<TaskNode> inbox;          // 外部线程投递任务的收件箱
+        Parker parker;                      // 休眠/唤醒令牌
+        std::atomic<bool> retire{false};    // 退出令牌：把自己的任务转交给其他线程后退出
+        std::atomic<bool> exited{true};     // 该槽位没有运行中的线程（未启动或已退出），收件箱由自动伸缩线程清理
+        std::atomic<uint64_t> busyNs{0};    // 累计执行任务的时间
+        std::atomic<uint64_t> completed{0}; // 累计完成的任务数
+    };
+
+    // 排队时间直方图：第 k 个桶统计 [2^k, 2^(k+1)) 微秒的任务数
+    static constexpr size_t kWaitBuckets = 32;
+
+    // 自旋参数：每轮查找一次任务，轮与轮之间执行若干次 pause 指令
+    static constexpr int kSpinRounds = 32;
+    static constexpr int kPausesPerRound = 16;
+
     // 私有成员变量
-    std::vector<std::thread> workers; // 工作线程集合
-    std::vector<std::unique_ptr<std::mutex>> localMutexes; // 每个本地任务队列对应的互斥锁
-    std::vector<std::deque<std::function<void()>>> localTasks; // 本地任务队列集合
-    std::condition_variable condition; // 条件变量，用于线程同步
+    std::vector<std::unique_ptr<Worker>> workers; // 工作线程集合（按 maxThreads 预分配）
     std::atomic<bool> stop; // 原子变量，标记线程池是否停止
     size_t minThreads, maxThreads; // 最小和最大线程数
-    std::atomic<size_t> activeThreads; // 当前活跃的线程数
-    
-    // 添加工作线程到线程池
+    std::atomic<size_t> workerCount; // 已启动的工作线程数
+    std::atomic<uint64_t> parkedMask;   // 第 i 位表示第 i 个线程已经（或即将）在 futex 上休眠
+    std::atomic<uint64_t> spinningMask; // 第 i 位表示第 i 个线程正在自旋查找任务
+    NodePool nodePool; // 任务节点池
+
+    // 自动伸缩相关
+    AutoscaleOptions options;
+    const bool autoscaling;                         // min < max 时才需要自动伸缩
+    std::thread scaler;                             // 自动伸缩线程
+    Parker scalerParker;                            // 自动伸缩线程的唤醒令牌
+    std::atomic<bool> scaleSignal;                  // 已有慢任务通知过自动伸缩线程，避免重复唤醒
+    std::atomic<uint64_t> waitHistogram[kWaitBuckets] = {}; // 排队时间直方图（累计值）
+    std::atomic<double> utilizationEwma{0.0};
+    std::atomic<uint64_t> p99WaitUs{0};
+    std::atomic<uint64_t> scaleUps{0};
+    std::atomic<uint64_t> scaleDowns{0};
+
+    // 准入控制相关
+    std::atomic<size_t> queuedTasks{0};     // 已提交但尚未开始执行的任务数
+    std::atomic<size_t> queueHigh{0};       // 高水位，0 表示不限制
+    std::atomic<size_t> queueLow{0};        // 低水位
+    std::atomic<bool> overloadedFlag{false};
+    std::atomic<uint64_t> rejectedTasks{0};
+
+    static uint64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // 当前线程所属的线程池及其下标，用于识别“池内线程提交任务”
+    static thread_local ThreadPool* currentPool;
+    static thread_local size_t currentIndex;
+
+    // 线程局部的 xorshift 随机数，用于随机选择投递目标和窃取对象
+    static size_t nextRandom() {
+        static thread_local uint64_t state =
+            std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return static_cast<size_t>(state);
+    }
+
+    // 自旋等待时提示 CPU 降低功耗、让出流水线
+    static void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    // 从掩码中随机挑选一个置位的线程下标（mask 不能为 0）
+    static size_t pickRandomBit(uint64_t mask) {
+        unsigned shift = nextRandom() % 64;
+        uint64_t rotated = (mask >> shift) | (shift ? mask << (64 - shift) : 0);
+        return (__builtin_ctzll(rotated) + shift) % 64;
+    }
+
+    // 当前已启动线程对应的掩码
+    uint64_t liveMask(size_t count) const {
+        return count >= 64 ? ~0ULL : ((1ULL << count) - 1);
+    }
+
+    // 如果线程 i 处于休眠状态，则“认领”它并发放唤醒令牌；认领失败说明它已醒来或已被别人唤醒
+    bool unparkWorker(size_t i) {
+        uint64_t bit = 1ULL << i;
+        if ((parkedMask.load(std::memory_order_seq_cst) & bit) &&
+            (parkedMask.fetch_and(~bit, std::memory_order_seq_cst) & bit)) {
+            workers[i]->parker.unpark();
+            return true;
+        }
+        return false;
+    }
+
+    // 从节点池取出节点，并把可调用对象构造进去
+    template<typename F>
+    TaskNode* makeNode(F&& f) {
+        TaskNode* node = nodePool.acquire();
+        node->fn = UniqueFunction<void()>(std::forward<F>(f));
+        node->enqueueNs = nowNs();
+        queuedTasks.fetch_add(1, std::memory_order_relaxed);
+        return node;
+    }
+
+    // 投递任务：池内线程直接压入自己的双端队列，外部线程投递到某个线程的收件箱
+    // 目标选择顺序：正在自旋的线程（无需唤醒）-> 休眠的线程（唤醒它）-> 随机线程
+    void submit(TaskNode* node) {
+        if (currentPool == this) {
+            workers[currentIndex]->deque.push(node);
+            // 本线程正忙，若没有自旋线程则叫醒一个休眠线程来窃取
+            wakeIdlePeer(currentIndex);
+            return;
+        }
+        size_t count = workerCount.load(std::memory_order_acquire);
+        uint64_t live = liveMask(count);
+        size_t target;
+        if (uint64_t spinning = spinningMask.load(std::memory_order_relaxed) & live) {
+            target = pickRandomBit(spinning);
+        } else if (uint64_t parked = parkedMask.load(std::memory_order_relaxed) & live) {
+            target = pickRandomBit(parked);
+        } else {
+            target = nextRandom() % count;
+        }
+        workers[target]->inbox.push(node);
+        // 先入队再检查休眠标记；线程休眠前先置位再检查收件箱，两边都用 seq_cst，因此不会丢失唤醒
+        unparkWorker(target);
+        // 按旧的线程数投递给了已经退出的线程：叫醒自动伸缩线程立即转投，不等下一个评估周期
+        if (workers[target]->exited.load(std::memory_order_seq_cst)) {
+            scalerParker.unpark();
+        }
+    }
+
+    // 添加工作线程到线程池（构造函数或自动伸缩线程调用）
     void addWorkers(size_t numberOfWorkers) {
-        // 循环创建指定数量的工作线程
-        for (size_t i = 0; i < numberOfWorkers; ++i) {
-            // 向工作线程集合中添加新线程
-            workers.emplace_back([this, i] {
-                while (true) {
-                    std::function<void()> task;
-                    {
-                        // 对当前线程的本地互斥锁上锁
-                        std::unique_lock<std::mutex> lock(*this->localMutexes[i]);
-                        // 等待直到有任务可执行或线程池停止
-                        this->condition.wait(lock, [this, i, &task] {
-                            // 如果设置了停止标志、本地任务队列非空、或成功从其他线程窃取任务，则继续
-                            return this->stop || !this->localTasks[i].empty() || tryStealTask(i, task);
-                        });
-                        // 如果线程池停止且当前线程的任务队列为空，且没有从其他线程窃取到任务，则退出循环
-                        if (this->stop && this->localTasks[i].empty() && !task) return;
-                        // 如果未从其他线程窃取到任务，且本地任务队列非空，则从本地队列取出任务执行
-                        if (!task && !this->localTasks[i].empty()) {
-                            task = std::move(this->localTasks[i].front());
-                            this->localTasks[i].pop_front();
-                        }
+        for (size_t n = 0; n < numberOfWorkers; ++n) {
+            size_t i = workerCount.load();
+            if (i >= maxThreads) return;
+            Worker& w = *workers[i];
+            if (w.th.joinable()) {
+                // 该槽位上被回收的线程还在转交任务，下次再扩容
+                if (!w.exited.load(std::memory_order_seq_cst)) return;
+                reapWorker(w);
+            }
+            w.exited.store(false, std::memory_order_seq_cst);
+            w.th = std::thread(&ThreadPool::workerLoop, this, i);
+            // 活跃线程数增加，新线程从此刻起可以接收任务、被窃取
+            workerCount.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    // 回收编号最大的工作线程：先停止向它投递，再发放退出令牌后立即返回
+    // 线程执行完当前任务后把剩余任务转交出去并退出，由之后的 drainRetiredSlots 回收，自动伸缩线程不等待它
+    void retireWorker() {
+        size_t i = workerCount.load() - 1;
+        Worker& w = *workers[i];
+        workerCount.store(i, std::memory_order_seq_cst);
+        w.retire.store(true, std::memory_order_seq_cst);
+        parkedMask.fetch_and(~(1ULL << i), std::memory_order_seq_cst);
+        w.parker.unpark();
+    }
+
+    // 已经退出的线程：join（不会阻塞）并清除退出令牌
+    void reapWorker(Worker& w) {
+        w.th.join();
+        w.retire.store(false, std::memory_order_relaxed);
+    }
+
+    // 回收已退出的线程，并把它们收件箱中残留的任务（按旧线程数投递的）重新投递出去
+    // 只处理 exited 的槽位：此时没有其他消费者，自动伸缩线程是唯一的消费者
+    void drainRetiredSlots() {
+        for (size_t i = workerCount.load(); i < maxThreads; ++i) {
+            Worker& w = *workers[i];
+            if (!w.exited.load(std::memory_order_seq_cst)) continue; // 仍在转交任务
+            if (w.th.joinable()) reapWorker(w);
+            // size 在入队前就已增加，生产者尚未完成链接时 pop 会暂时返回空，稍等即可
+            while (!w.inbox.empty()) {
+                if (TaskNode* node = w.inbox.pop()) {
+                    submit(node);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+            while (TaskNode* node = w.deque.pop()) submit(node);
+        }
+    }
+
+    // 被回收的线程退出前调用：把本地队列和收件箱中的任务转交给仍在运行的线程
+    void handOffAndExit(Worker& self) {
+        currentPool = nullptr; // 之后的 submit 按外部线程处理，投递到其他线程的收件箱
+        while (TaskNode* node = self.deque.pop()) submit(node);
+        while (TaskNode* node = self.inbox.pop()) submit(node);
+        self.exited.store(true, std::memory_order_seq_cst);
+        // 与 submit 中“先入队再检查 exited”配对：两边至少有一方发现残留任务并叫醒自动伸缩线程
+        if (!self.inbox.empty()) {
+            scalerParker.unpark();
+        }
+    }
+
+    // 自动伸缩线程：平时按 evaluateInterval 周期评估，出现慢任务时被立即唤醒
+    void autoscaleLoop() {
+        uint64_t prevHistogram[kWaitBuckets] = {};
+        uint64_t prevBusyNs = totalBusyNs();
+        uint64_t lastEvaluate = nowNs();
+        uint64_t lastScaleUp = 0;
+        uint64_t idleSince = 0;
+        while (!stop) {
+            scalerParker.parkFor(options.evaluateInterval);
+            if (stop) return;
+            scaleSignal.store(false, std::memory_order_relaxed);
+            uint64_t now = nowNs();
+
+            // 1) 最近窗口的 p99 排队时间
+            uint64_t window[kWaitBuckets];
+            uint64_t total = 0;
+            for (size_t k = 0; k < kWaitBuckets; ++k) {
+                uint64_t cur = waitHistogram[k].load(std::memory_order_relaxed);
+                window[k] = cur - prevHistogram[k];
+                prevHistogram[k] = cur;
+                total += window[k];
+            }
+            uint64_t p99 = 0;
+            if (total > 0) {
+                uint64_t rank = total - total / 100; // 第 99 百分位所在的序号
+                uint64_t seen = 0;
+                for (size_t k = 0; k < kWaitBuckets; ++k) {
+                    seen += window[k];
+                    if (seen >= rank) {
+                        p99 = (1ULL << (k + 1)) - 1; // 取桶上界，偏保守
+                        break;
                     }
-                    // 执行获取到的任务
-                    if (task) task();
                 }
-            });
-            // 活跃线程数增加
-            activeThreads.fetch_add(1);
-        }
-    }
-
-    // 尝试从其他线程的本地任务队列中窃取任务
-    bool tryStealTask(size_t thiefIndex, std::function<void()>& task) {
-        for (size_t i = 0; i < localTasks.size(); ++i) {
-            if (i != thiefIndex && !localTasks[i].empty()) {
-                // 上锁目标线程的互斥锁
-                std::lock_guard<std::mutex> lock(*localMutexes[i]);
-                if (!localTasks[i].empty()) {
-                    // 从任务队列尾部取出任务执行，实现窃取
-                    task = std::move(localTasks[i].back());
-                    localTasks[i].pop_back();
-                    return true; // 窃取成功
+            }
+            p99WaitUs.store(p99, std::memory_order_relaxed);
+
+            // 2) 线程利用率 EWMA（窗口太短时不更新，避免噪声）
+            size_t count = workerCount.load();
+            uint64_t elapsed = now - lastEvaluate;
+            if (elapsed >= 10 * 1000000ULL) {
+                uint64_t busy = totalBusyNs();
+                double util = static_cast<double>(busy - prevBusyNs) / (static_cast<double>(elapsed) * count);
+                if (util > 1.0) util = 1.0;
+                double ewma = options.ewmaAlpha * util + (1 - options.ewmaAlpha) * utilizationEwma.load();
+                utilizationEwma.store(ewma, std::memory_order_relaxed);
+                prevBusyNs = busy;
+                lastEvaluate = now;
+            }
+
+            // 3) 扩容：p99 超过目标立即加一个线程
+            uint64_t target = static_cast<uint64_t>(options.targetWait.count());
+            uint64_t cooldown = std::chrono::duration_cast<std::chrono::nanoseconds>(options.scaleUpCooldown).count();
+            if (p99 > target && count < maxThreads) {
+                if (now - lastScaleUp >= cooldown) {
+                    addWorkers(1);
+                    scaleUps.fetch_add(1, std::memory_order_relaxed);
+                    lastScaleUp = now;
                 }
+                idleSince = 0;
+            } else if (count > minThreads && p99 <= target / 2 &&
+                       utilizationEwma.load() < options.idleUtilization) {
+                // 4) 缩容：持续空闲 retireAfter 之后回收一个线程
+                uint64_t retireNs = std::chrono::duration_cast<std::chrono::nanoseconds>(options.retireAfter).count();
+                if (idleSince == 0) {
+                    idleSince = now;
+                } else if (now - idleSince >= retireNs) {
+                    retireWorker();
+                    scaleDowns.fetch_add(1, std::memory_order_relaxed);
+                    idleSince = now;
+                }
+            } else {
+                idleSince = 0;
             }
+            drainRetiredSlots();
         }
-        return false; // 窃取失败
     }
 
-    // 选择最少负载的线程
-    size_t selectLeastLoadedThread() {
-        size_t leastLoaded = 0;
-        size_t minSize = std::numeric_limits<size_t>::max();
-        for (size_t i = 0; i < localTasks.size(); ++i) {
-            std::lock_guard<std::mutex> lock(*localMutexes[i]);
-            if (localTasks[i].size() < minSize) {
-                leastLoaded = i;
-                minSize = localTasks[i].size();
-            }
+    uint64_t totalBusyNs() const {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < maxThreads; ++i) {
+            sum += workers[i]->busyNs.load(std::memory_order_relaxed);
         }
-        return leastLoaded;// 返回最少负载的线程索引
+        return sum;
     }
 
-    // 动态调整线程池大小
-    void adjustThreadPoolSize() {
-        if (stop) return; // 如果线程池已经停止，则不进行调整
-        size_t currentSize = workers.size();
-        // 计算期望的线程数量
-        size_t desiredSize = std::min(std::max(minThreads, activeThreads.load()), maxThreads);
-        // 如果当前线程数少于期望线程数，则增加线程
-        if (currentSize < desiredSize) {
-            addWorkers(desiredSize - currentSize);
-        } else if (currentSize > desiredSize) {
-            // 如果当前线程数多于期望线程数，则减少线程
-            reduceWorkers(currentSize - desiredSize);
+    // 记录一次排队时间，超过目标时唤醒自动伸缩线程
+    void recordWait(uint64_t waitNs) {
+        uint64_t us = waitNs / 1000;
+        size_t bucket = us == 0 ? 0 : 63 - __builtin_clzll(us);
+        if (bucket >= kWaitBuckets) bucket = kWaitBuckets - 1;
+        waitHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+        if (us > static_cast<uint64_t>(options.targetWait.count()) && autoscaling &&
+            !scaleSignal.exchange(true, std::memory_order_relaxed)) {
+            scalerParker.unpark();
         }
     }
 
-    /*
-    // 动态调整线程池大小
-    void adjustThreadPoolSize() {
-        if (stop) return; // 如果线程池已经停止，则不进行调整
+    // 工作线程主循环：执行任务 -> 自旋查找 -> futex 休眠
+    void workerLoop(size_t index) {
+        currentPool = this;
+        currentIndex = index;
+        Worker& self = *workers[index];
+        uint64_t bit = 1ULL << index;
+        while (true) {
+            // 收到退出令牌：把剩余任务转交出去后退出
+            if (self.retire.load(std::memory_order_acquire)) {
+                handOffAndExit(self);
+                return;
+            }
+            TaskNode* task = findTask(index);
+            if (!task) {
+                task = spinForTask(index);
+            }
+            if (task) {
+                runTask(self, task);
+                continue;
+            }
+            if (this->stop && self.inbox.empty() && self.deque.empty()) return;
 
-        // 获取当前任务队列的总任务数
-        size_t totalTasks = 0;
-        for (const auto& queue : localTasks) {
-            std::lock_guard<std::mutex> lock(*localMutexes[queue.first]);
-            totalTasks += queue.second.size();
+            // 没有可执行的任务，准备休眠：先置位休眠标记，再检查一次收件箱
+            parkedMask.fetch_or(bit, std::memory_order_seq_cst);
+            if (this->stop || self.retire.load(std::memory_order_seq_cst) || !self.inbox.empty() || !self.deque.empty()) {
+                parkedMask.fetch_and(~bit, std::memory_order_seq_cst);
+                continue;
+            }
+            self.parker.park();
+            // 正常情况下唤醒者已经清除了标记；被停止或多余令牌唤醒时在这里自己清除
+            parkedMask.fetch_and(~bit, std::memory_order_seq_cst);
         }
+    }
 
-        // 获取当前活跃（工作中或可工作）的线程数
-        size_t currentActiveThreads = activeThreads.load();
-
-        // 根据当前任务量和活跃线程数确定是否需要调整线程数
-        if (totalTasks > currentActiveThreads && workers.size() < maxThreads) {
-            // 如果任务多于活跃线程数且当前线程总数小于最大限制，则增加线程
-            size_t threadsToAdd = std::min(maxThreads - workers.size(), totalTasks - currentActiveThreads);
-            addWorkers(threadsToAdd);
-        } else if (totalTasks < currentActiveThreads / 2 && workers.size() > minThreads) {
-            // 如果任务数少于活跃线程数的一半且当前线程总数大于最小限制，则减少线程
-            size_t threadsToRemove = std::min(workers.size() - minThreads, currentActiveThreads - totalTasks / 2);
-            reduceWorkers(threadsToRemove);
+    // 自旋阶段：在进入 futex 休眠前短暂轮询，接住紧随而来的任务
+    // 同时自旋的线程不超过一半，避免空转占满 CPU
+    TaskNode* spinForTask(size_t index) {
+        size_t count = workerCount.load(std::memory_order_acquire);
+        uint64_t bit = 1ULL << index;
+        uint64_t spinning = spinningMask.load(std::memory_order_relaxed);
+        if (static_cast<size_t>(__builtin_popcountll(spinning)) * 2 >= count) {
+            return nullptr;
         }
+        spinningMask.fetch_or(bit, std::memory_order_seq_cst);
+        TaskNode* task = nullptr;
+        for (int round = 0; round < kSpinRounds && !task && !this->stop; ++round) {
+            for (int k = 0; k < kPausesPerRound; ++k) cpuRelax();
+            task = findTask(index);
+        }
+        spinningMask.fetch_and(~bit, std::memory_order_seq_cst);
+        return task;
     }
 
-    
-    */
+    // 按优先级查找任务：本地队列 -> 收件箱 -> 随机窃取
+    TaskNode* findTask(size_t index) {
+        Worker& self = *workers[index];
+        if (TaskNode* task = self.deque.pop()) {
+            return task;
+        }
+        // 把收件箱里的任务搬到本地队列，这样其他线程也能窃取它们
+        if (TaskNode* task = self.inbox.pop()) {
+            bool moved = false;
+            while (TaskNode* more = self.inbox.pop()) {
+                self.deque.push(more);
+                moved = true;
+            }
+            if (moved) wakeIdlePeer(index);
+            return task;
+        }
+        return trySteal(index);
+    }
 
-    // 减少工作线程
-    void reduceWorkers(size_t count) {
-        for (size_t i = 0; i < count; ++i) {
-            stopWorker();
+    // 随机选择窃取对象，尝试若干次
+    TaskNode* trySteal(size_t thiefIndex) {
+        size_t count = workerCount.load(std::memory_order_acquire);
+        if (count < 2) return nullptr;
+        for (size_t attempt = 0; attempt < count * 2; ++attempt) {
+            size_t victim = nextRandom() % count;
+            if (victim == thiefIndex) continue;
+            if (TaskNode* task = workers[victim]->deque.steal()) {
+                return task;
+            }
         }
+        return nullptr;
     }
 
+    // 唤醒一个休眠线程来窃取任务；已有线程在自旋时它们会负责窃取，无需唤醒
+    void wakeIdlePeer(size_t selfIndex) {
+        if (spinningMask.load(std::memory_order_seq_cst) != 0) return;
+        while (uint64_t parked = parkedMask.load(std::memory_order_seq_cst) & ~(1ULL << selfIndex)) {
+            if (unparkWorker(pickRandomBit(parked))) return;
+        }
+    }
 
-    // 停止一个工作线程
-    void stopWorker() {
-        stop = true; // 临时设置停止标志以终止一个线程
-        condition.notify_one(); // 通知一个等待的线程
-        if (workers.back().joinable()) {
-            workers.back().join(); // 等待最后一个线程完成
-            workers.pop_back(); // 从工作线程列表中移除
-            activeThreads.fetch_sub(1); // 活跃线程数减少
+    // 执行任务并把任务节点归还节点池，同时记录排队时间和忙碌时间
+    void runTask(Worker& self, TaskNode* task) {
+        uint64_t start = nowNs();
+        queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+        recordWait(start - task->enqueueNs);
+        try {
+            task->fn();
+        } catch (...) {
+            // packaged_task 会把异常保存到 future 中，这里只防止线程意外退出
         }
-        stop = false; // 重置停止标志，以便其它线程继续工作
+        task->fn = nullptr; // 立即析构捕获的对象
+        nodePool.release(task);
+        self.busyNs.fetch_add(nowNs() - start, std::memory_order_relaxed);
+        self.completed.fetch_add(1, std::memory_order_relaxed);
     }
 
     // 停止线程池中所有线程的工作
     void stopPool() {
         stop = true; // 设置停止标志
-        condition.notify_all(); // 唤醒所有等待的线程
-        for (auto& worker : workers) {
-            if (worker.joinable()) worker.join(); // 等待每个线程完成
+        // 先停止自动伸缩线程，之后线程数不再变化
+        scalerParker.unpark();
+        if (scaler.joinable()) scaler.join();
+        size_t count = workerCount.load();
+        // 先等正在回收的线程把任务转交给运行中的线程
+        for (size_t i = count; i < maxThreads; ++i) {
+            if (workers[i]->th.joinable()) workers[i]->th.join();
+        }
+        for (size_t i = 0; i < count; ++i) {
+            workers[i]->parker.unpark(); // 给每个线程发放令牌，唤醒所有休眠的线程
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (workers[i]->th.joinable()) workers[i]->th.join(); // 等待每个线程完成
+        }
+        // 关闭过程中转交的任务可能落在已经退出的线程上，由当前线程执行完，不丢任务
+        for (size_t i = 0; i < maxThreads; ++i) {
+            Worker& w = *workers[i];
+            if (w.th.joinable()) w.th.join();
+            while (TaskNode* node = w.deque.pop()) runTask(w, node);
+            while (!w.inbox.empty()) {
+                if (TaskNode* node = w.inbox.pop()) runTask(w, node);
+            }
         }
     }
-    
+
 };
 
+// static 成员需在类外定义
+thread_local ThreadPool* ThreadPool::currentPool = nullptr;
+thread_local size_t ThreadPool::currentIndex = 0;
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// UniqueFunction：只可移动的函数包装器，带 48 字节内联存储（连同虚表指针对齐后共 64 字节，一个缓存行）
+// 与 std::function 相比：
+//   1) 可以保存只可移动的可调用对象（如 std::packaged_task、捕获 unique_ptr 的 lambda）
+//   2) 小于内联存储的可调用对象不会发生堆分配
+// 超出内联存储的可调用对象退化为堆分配，行为与 std::function 一致
+template <typename Signature>
+class UniqueFunction;
+
+template <typename R, typename... Args>
+class UniqueFunction<R(Args...)> {
+public:
+    static constexpr size_t kInlineSize = 48;
+
+    UniqueFunction() noexcept : ops_(nullptr) {}
+    UniqueFunction(std::nullptr_t) noexcept : ops_(nullptr) {}
+
+    template <typename F,
+              typename = std::enable_if_t<!std::is_same<std::decay_t<F>, UniqueFunction>::value>>
+    UniqueFunction(F&& f) : ops_(nullptr) {
+        using Fn = std::decay_t<F>;
+        if (fitsInline<Fn>()) {
+            new (&storage_) Fn(std::forward<F>(f));
+            ops_ = &InlineOps<Fn>::table;
+        } else {
+            *reinterpret_cast<Fn**>(&storage_) = new Fn(std::forward<F>(f));
+            ops_ = &HeapOps<Fn>::table;
+        }
+    }
+
+    UniqueFunction(UniqueFunction&& other) noexcept : ops_(other.ops_) {
+        if (ops_) {
+            ops_->move(&other.storage_, &storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    UniqueFunction& operator=(UniqueFunction&& other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other.ops_) {
+                other.ops_->move(&other.storage_, &storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    UniqueFunction& operator=(std::nullptr_t) noexcept {
+        reset();
+        return *this;
+    }
+
+    UniqueFunction(const UniqueFunction&) = delete;
+    UniqueFunction& operator=(const UniqueFunction&) = delete;
+
+    ~UniqueFunction() { reset(); }
+
+    R operator()(Args... args) {
+        return ops_->invoke(&storage_, std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    // 可调用对象 F 能否放进内联存储（不发生堆分配）
+    template <typename F>
+    static constexpr bool fitsInline() {
+        return sizeof(F) <= kInlineSize && alignof(F) <= alignof(Storage) &&
+               std::is_nothrow_move_constructible<F>::value;
+    }
+
+private:
+    using Storage = std::aligned_storage_t<kInlineSize, alignof(std::max_align_t)>;
+
+    // 手写虚表：调用、移动、析构
+    struct Ops {
+        R (*invoke)(void*, Args&&...);
+        void (*move)(void* from, void* to) noexcept;
+        void (*destroy)(void*) noexcept;
+    };
+
+    // 内联存储：对象直接构造在 storage_ 中
+    template <typename F>
+    struct InlineOps {
+        static R invoke(void* p, Args&&... args) {
+            return (*static_cast<F*>(p))(std::forward<Args>(args)...);
+        }
+        static void move(void* from, void* to) noexcept {
+            new (to) F(std::move(*static_cast<F*>(from)));
+            static_cast<F*>(from)->~F();
+        }
+        static void destroy(void* p) noexcept { static_cast<F*>(p)->~F(); }
+        static constexpr Ops table = {&invoke, &move, &destroy};
+    };
+
+    // 堆存储：storage_ 中只保存指针
+    template <typename F>
+    struct HeapOps {
+        static R invoke(void* p, Args&&... args) {
+            return (**static_cast<F**>(p))(std::forward<Args>(args)...);
+        }
+        static void move(void* from, void* to) noexcept {
+            *static_cast<F**>(to) = *static_cast<F**>(from);
+        }
+        static void destroy(void* p) noexcept { delete *static_cast<F**>(p); }
+        static constexpr Ops table = {&invoke, &move, &destroy};
+    };
+
+    void reset() noexcept {
+        if (ops_) {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    Storage storage_;
+    const Ops* ops_;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Chase-Lev 无锁工作窃取双端队列
+// 只有拥有者线程可以在底部 push/pop；其他线程（窃取者）通过 CAS 从顶部 steal
+// T 必须是指针类型，空队列或窃取失败时返回 nullptr
+template <typename T>
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(size_t capacity = 256)
+        : top_(0), bottom_(0) {
+        size_t cap = 1;
+        while (cap < capacity) cap <<= 1; // 容量取 2 的幂，方便用掩码取模
+        auto array = std::make_unique<Array>(cap);
+        array_.store(array.get(), std::memory_order_relaxed);
+        arrays_.push_back(std::move(array));
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // 拥有者线程：在底部压入一个元素，容量不足时自动扩容
+    void push(T item) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        Array* a = array_.load(std::memory_order_relaxed);
+        if (b - t > static_cast<int64_t>(a->capacity) - 1) {
+            a = grow(a, b, t);
+        }
+        a->put(b, item);
+        bottom_.store(b + 1, std::memory_order_release); // 发布元素，窃取者 acquire 读取 bottom 后可见
+    }
+
+    // 拥有者线程：从底部弹出一个元素（LIFO，缓存更热）
+    T pop() {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array* a = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            // 队列为空，恢复 bottom
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T item = a->get(b);
+        if (t == b) {
+            // 只剩最后一个元素，与窃取者竞争
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed)) {
+                item = nullptr; // 被窃取者抢走
+            }
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // 任意线程：从顶部窃取一个元素（FIFO），失败或为空时返回 nullptr
+    T steal() {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        Array* a = array_.load(std::memory_order_acquire);
+        T item = a->get(t);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            return nullptr; // 与其他窃取者或拥有者竞争失败
+        }
+        return item;
+    }
+
+    // 近似长度，仅用于统计和负载判断
+    size_t size() const {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+private:
+    // 环形数组，槽位是原子的，窃取者可以与拥有者并发读取
+    struct Array {
+        size_t capacity;
+        size_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+
+        explicit Array(size_t cap)
+            : capacity(cap), mask(cap - 1), slots(new std::atomic<T>[cap]) {}
+
+        T get(int64_t i) const {
+            return slots[static_cast<size_t>(i) & mask].load(std::memory_order_relaxed);
+        }
+        void put(int64_t i, T item) {
+            slots[static_cast<size_t>(i) & mask].store(item, std::memory_order_relaxed);
+        }
+    };
+
+    alignas(64) std::atomic<int64_t> top_;    // 窃取端，与 bottom_ 分处不同缓存行
+    alignas(64) std::atomic<int64_t> bottom_; // 拥有者端
+    std::atomic<Array*> array_;
+    // 扩容后的旧数组可能仍被窃取者读取，统一保留到析构时释放（只有拥有者线程会修改）
+    std::vector<std::unique_ptr<Array>> arrays_;
+
+    // 容量翻倍，把 [t, b) 区间的元素复制到新数组
+    Array* grow(Array* old, int64_t b, int64_t t) {
+        auto bigger = std::make_unique<Array>(old->capacity * 2);
+        for (int64_t i = t; i < b; ++i) {
+            bigger->put(i, old->get(i));
+        }
+        Array* raw = bigger.get();
+        arrays_.push_back(std::move(bigger));
+        array_.store(raw, std::memory_order_release);
+        return raw;
+    }
+};
@@ -0,0 +1,351 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <openssl/evp.h>
+
+// 按内容寻址的文件存储（去重）
+// 文件内容按 SHA-256 保存一次：<dir>/.store/sha256/xx/yy/<摘要>（xx、yy 为摘要前四位，避免单个目录过大）
+// <dir>/<文件名> 是内容的一份独立文件，所以按文件名下载、列目录（包括 nginx 直接读目录）的代码都不用改
+// 文件名从存储中 reflink 出来（btrfs、XFS 等共享数据块，写时复制），不支持 reflink 的文件系统上由内核复制
+// 文件名之间、文件名与存储之间不共享 inode：原地改写一个文件名不会改动其它文件名，也不会改动存储中的内容
+// 同名上传原子地替换为新内容，旧内容仍保留在存储中
+// 文件名到摘要的索引保存在内存中，按 inode、大小、mtime、ctime 判断文件是否变化：
+// 变化了（外部新建、替换或原地改写）就在 lookup 时重新计算摘要，文件本身不做任何改动；重启后第一次访问时计算
+class BlobStore {
+public:
+    struct Blob {
+        std::string digest; // SHA-256 hex，同时用作 ETag
+        uint64_t size = 0;
+    };
+
+    struct PutResult {
+        Blob blob;
+        bool deduplicated = false; // 内容已存在，没有写盘
+    };
+
+    explicit BlobStore(const std::string& dir)
+        : dir_(dir), store_(dir + "/.store/sha256") {
+        std::filesystem::create_directories(store_);
+        load();
+    }
+
+    BlobStore(const BlobStore&) = delete;
+    BlobStore& operator=(const BlobStore&) = delete;
+
+    // 文件名不能为空、不能包含 '/'，以 '.' 开头的名字留给存储自己使用
+    static bool isValidName(const std::string& name) {
+        return !name.empty() && name.size() <= 255 && name[0] != '.' &&
+               name.find('/') == std::string::npos && name.find('\0') == std::string::npos;
+    }
+
+    static bool isValidDigest(const std::string& digest) {
+        return digest.size() == 64 && digest.find_first_not_of("0123456789abcdef") == std::string::npos;
+    }
+
+    // 保存内容并让 name 指向它；内容已存在时只建立链接
+    PutResult put(const std::string& name, const std::string& data) {
+        PutResult result;
+        result.blob.digest = sha256Hex(data.data(), data.size());
+        result.blob.size = data.size();
+        result.deduplicated = contains(result.blob.digest);
+        if (!result.deduplicated) {
+            writeBlob(result.blob.digest, data);
+        }
+        bind(name, result.blob);
+        return result;
+    }
+
+    // 按摘要引用已有内容（客户端已知摘要时不用再上传数据）；内容不存在时返回 false
+    bool link(const std::string& name, const std::string& digest, Blob& out) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = digests_.find(digest);
+            if (it == digests_.end()) {
+                return false;
+            }
+            out.digest = digest;
+            out.size = it->second;
+        }
+        bind(name, out);
+        return true;
+    }
+
+    // 查询文件名当前的内容；以磁盘为准：
+    // 文件已被删除时从索引中去掉；与索引记录的 inode、大小、mtime、ctime 不符时重新计算摘要（只读，不改动文件）
+    bool lookup(const std::string& name, Blob& out) {
+        int fd = ::open(pathOf(name).c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd < 0 || ::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            if (fd >= 0) ::close(fd);
+            std::lock_guard<std::mutex> lock(mutex_);
+            names_.erase(name);
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = names_.find(name);
+            if (it != names_.end() && it->second.matches(st)) {
+                ::close(fd);
+                out = it->second.blob;
+                return true;
+            }
+        }
+        // 记录的是读之前的状态：读的过程中文件又被改写时，下次 lookup 会再算一次
+        bool ok = sha256File(fd, out);
+        ::close(fd);
+        if (!ok) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        names_[name] = Entry{out, st};
+        return true;
+    }
+
+    bool contains(const std::string& digest) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return digests_.count(digest) > 0;
+    }
+
+    // 按文件名访问的路径
+    std::string pathOf(const std::string& name) const {
+        return dir_ + "/" + name;
+    }
+
+    // 分块计算 SHA-256，返回 hex
+    static std::string sha256Hex(const char* data, size_t len) {
+        static const size_t kChunk = 64 * 1024;
+        EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+        bool ok = ctx && EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
+        for (size_t off = 0; ok && off < len; off += kChunk) {
+            ok = EVP_DigestUpdate(ctx, data + off, std::min(kChunk, len - off));
+        }
+        return finishSha256(ctx, ok);
+    }
+
+private:
+    // 索引中的一项：内容，以及计算摘要时文件的状态（任何一项变化都说明文件被替换或改写过）
+    struct Entry {
+        Blob blob;
+        uint64_t inode = 0;
+        int64_t mtimeNs = 0;
+        int64_t ctimeNs = 0;
+
+        Entry() = default;
+        Entry(const Blob& b, const struct stat& st)
+            : blob(b), inode(static_cast<uint64_t>(st.st_ino)),
+              mtimeNs(toNs(st.st_mtim)), ctimeNs(toNs(st.st_ctim)) {}
+
+        bool matches(const struct stat& st) const {
+            return inode == static_cast<uint64_t>(st.st_ino) && blob.size == static_cast<uint64_t>(st.st_size) &&
+                   mtimeNs == toNs(st.st_mtim) && ctimeNs == toNs(st.st_ctim);
+        }
+
+        static int64_t toNs(const struct timespec& ts) {
+            return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+        }
+    };
+
+    std::string dir_;
+    std::string store_;
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> names_;       // 文件名 -> 内容
+    std::unordered_map<std::string, uint64_t> digests_;  // 已保存的内容 -> 大小
+    std::atomic<uint64_t> tempCounter_{0};
+
+    std::string blobPath(const std::string& digest) const {
+        return store_ + "/" + digest.substr(0, 2) + "/" + digest.substr(2, 2) + "/" + digest;
+    }
+
+    // 临时文件名：同一目录下 rename 才是原子的
+    std::string tempName(const std::string& dir, const char* tag) {
+        return dir + "/." + tag + "-" + std::to_string(getpid()) + "-" + std::to_string(tempCounter_++);
+    }
+
+    // 先写临时文件再 rename，读者不会看到写了一半的内容
+    // 两个请求同时写同一份新内容时都会成功，rename 的结果相同
+    void writeBlob(const std::string& digest, const std::string& data) {
+        std::string finalPath = blobPath(digest);
+        std::string parent = finalPath.substr(0, finalPath.rfind('/'));
+        std::filesystem::create_directories(parent);
+        std::string tmp = tempName(parent, "tmp");
+        {
+            std::ofstream ofs(tmp, std::ios::binary);
+            ofs.write(data.data(), static_cast<std::streamsize>(data.size()));
+            if (!ofs) {
+                ofs.close();
+                ::unlink(tmp.c_str());
+                throw std::runtime_error("Failed to write blob " + digest);
+            }
+        }
+        ::chmod(tmp.c_str(), 0444); // 内容被多个文件名共享，不允许原地修改
+        if (::rename(tmp.c_str(), finalPath.c_str()) != 0) {
+            ::unlink(tmp.c_str());
+            throw std::runtime_error("Failed to store blob " + digest);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        digests_[digest] = data.size();
+    }
+
+    // 让 name 成为这份内容：先在临时名上复制出独立的文件，再 rename 覆盖原名（原子替换）
+    // 复制不持锁；rename 和更新索引持锁，保证同名并发上传时磁盘上的文件和内存索引一致
+    void bind(const std::string& name, const Blob& blob) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = names_.find(name);
+            struct stat st;
+            if (it != names_.end() && it->second.blob.digest == blob.digest &&
+                ::stat(pathOf(name).c_str(), &st) == 0 && it->second.matches(st)) {
+                return; // 已经是这份内容，且之后没有被改动过
+            }
+        }
+        std::string tmp = tempName(dir_, "copy");
+        materialize(blob.digest, tmp);
+        std::lock_guard<std::mutex> lock(mutex_);
+        struct stat st;
+        if (::rename(tmp.c_str(), pathOf(name).c_str()) != 0) {
+            ::unlink(tmp.c_str());
+            throw std::runtime_error("Failed to bind " + name + ": " + std::to_string(errno));
+        }
+        // rename 之后再取状态（有的文件系统 rename 会更新 ctime）
+        if (::stat(pathOf(name).c_str(), &st) == 0) {
+            names_[name] = Entry{blob, st};
+        } else {
+            names_.erase(name);
+        }
+    }
+
+    // 把存储中的内容复制到 target（新建，权限 0644）
+    // 先尝试 reflink（FICLONE，只复制元数据，数据块写时复制）；不支持时用 copy_file_range 在内核中复制
+    void materialize(const std::string& digest, const std::string& target) {
+        int src = ::open(blobPath(digest).c_str(), O_RDONLY | O_CLOEXEC);
+        if (src < 0) {
+            throw std::runtime_error("Missing blob " + digest);
+        }
+        int dst = ::open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (dst < 0) {
+            ::close(src);
+            throw std::runtime_error("Failed to create " + target + ": " + std::to_string(errno));
+        }
+        bool ok = ::ioctl(dst, FICLONE, src) == 0;
+        if (!ok) {
+            static const size_t kChunk = 16 * 1024 * 1024;
+            ssize_t n;
+            while ((n = ::copy_file_range(src, nullptr, dst, nullptr, kChunk, 0)) > 0) {
+            }
+            ok = n == 0;
+        }
+        int err = errno;
+        ::close(src);
+        if (::close(dst) != 0) {
+            ok = false;
+        }
+        if (!ok) {
+            ::unlink(target.c_str());
+            throw std::runtime_error("Failed to copy blob " + digest + ": " + std::to_string(err));
+        }
+    }
+
+    // 从已打开的文件读出全部内容计算 SHA-256；读失败返回 false
+    static bool sha256File(int fd, Blob& out) {
+        static const size_t kChunk = 64 * 1024;
+        std::vector<char> buffer(kChunk);
+        EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+        bool ok = ctx && EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
+        uint64_t size = 0;
+        ssize_t n;
+        while (ok && (n = ::read(fd, buffer.data(), buffer.size())) != 0) {
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                EVP_MD_CTX_free(ctx);
+                return false;
+            }
+            ok = EVP_DigestUpdate(ctx, buffer.data(), static_cast<size_t>(n));
+            size += static_cast<uint64_t>(n);
+        }
+        out.digest = finishSha256(ctx, ok);
+        out.size = size;
+        return true;
+    }
+
+    // 结束摘要计算并释放 ctx，返回 hex
+    static std::string finishSha256(EVP_MD_CTX* ctx, bool ok) {
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int digestLen = 0;
+        ok = ok && EVP_DigestFinal_ex(ctx, digest, &digestLen);
+        EVP_MD_CTX_free(ctx);
+        if (!ok) {
+            throw std::runtime_error("SHA-256 failed");
+        }
+        static const char kDigits[] = "0123456789abcdef";
+        std::string out(digestLen * 2, '\0');
+        for (unsigned int i = 0; i < digestLen; ++i) {
+            out[2 * i] = kDigits[digest[i] >> 4];
+            out[2 * i + 1] = kDigits[digest[i] & 0x0f];
+        }
+        return out;
+    }
+
+    // 启动时重建索引：记录存储中已有的内容
+    // 旧版本的文件名是指向存储的硬链接（与存储共享 inode），在这里换成独立的副本，之后改写文件名不会改动存储
+    // 其它文件名不读取，第一次 lookup 时再计算摘要
+    void load() {
+        namespace fs = std::filesystem;
+        std::unordered_map<std::string, std::string> byInode; // "dev:ino" -> 摘要
+        for (const auto& entry : fs::recursive_directory_iterator(store_)) {
+            if (!entry.is_regular_file()) {
+                continue;
+            }
+            std::string file = entry.path().filename().string();
+            if (!isValidDigest(file)) {
+                fs::remove(entry.path()); // 上次异常退出留下的临时文件
+                continue;
+            }
+            struct stat st;
+            if (::stat(entry.path().c_str(), &st) == 0) {
+                byInode[inodeKey(st)] = file;
+                digests_[file] = static_cast<uint64_t>(st.st_size);
+            }
+        }
+
+        for (const auto& entry : fs::directory_iterator(dir_)) {
+            std::string name = entry.path().filename().string();
+            if (!entry.is_regular_file()) {
+                continue;
+            }
+            if (!isValidName(name)) {
+                if (name.compare(0, 6, ".link-") == 0 || name.compare(0, 6, ".copy-") == 0) {
+                    fs::remove(entry.path());
+                }
+                continue;
+            }
+            struct stat st;
+            if (::stat(entry.path().c_str(), &st) != 0) {
+                continue;
+            }
+            auto it = byInode.find(inodeKey(st));
+            if (it != byInode.end()) {
+                bind(name, Blob{it->second, static_cast<uint64_t>(st.st_size)});
+            }
+        }
+    }
+
+    static std::string inodeKey(const struct stat& st) {
+        return std::to_string(st.st_dev) + ":" + std::to_string(st.st_ino);
+    }
+};
@@ -3,92 +3,271 @@
 
 #include <mongocxx/client.hpp>
 #include <mongocxx/instance.hpp>
+#include <mongocxx/pool.hpp>
+#include <mongocxx/uri.hpp>
+#include <mongocxx/options/find.hpp>
+#include <bsoncxx/oid.hpp>
+#include <bsoncxx/types.hpp>
 #include <bsoncxx/builder/stream/document.hpp>
 #include <bsoncxx/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
 #include <future>
 #include <iostream> // 添加标准输出库
+#include "ThreadPool.h"
 
+// MongoDB 连接配置
+struct MongoOptions {
+    std::string uri = "mongodb://127.0.0.1:27017";
+    size_t poolSize = 16;                          // 连接池中客户端的最大数量
+    std::chrono::milliseconds waitTimeout{2000};   // 借客户端的最长等待时间，超时抛出异常
+    size_t executorThreads = 0;                    // 执行阻塞驱动调用的线程数，0 表示与 poolSize 相同
+    size_t executorQueue = 1024;                   // 执行器队列上限，满时异步调用直接失败
+};
+
+// 连接池指标
+struct MongoPoolStats {
+    size_t poolSize = 0;         // 客户端上限
+    size_t inUse = 0;            // 当前借出的客户端数
+    size_t peakInUse = 0;        // 借出数的峰值
+    uint64_t acquisitions = 0;   // 成功借出的次数
+    uint64_t timeouts = 0;       // 等待超时的次数
+    double avgWaitUs = 0;        // 平均等待时间
+    double maxWaitUs = 0;        // 最长等待时间
+    double utilization = 0;      // 自启动以来客户端被占用的时间比例（占用时间总和 / (运行时间 * poolSize)）
+};
+
+// mongocxx::client 不是线程安全的，不能被多个工作线程同时使用
+// 这里使用 mongocxx::pool：每次操作从池中借一个客户端，用完归还
+// 同时借出的客户端数量由本类自己计数限制，超过 waitTimeout 仍借不到时抛出异常，而不是无限阻塞
 class Database {
 private:
-    mongocxx::instance instance{}; // 全局实例
-    mongocxx::client client;       // MongoDB 客户端
-    mongocxx::database db;         // 数据库
+    mongocxx::instance instance{}; // 全局实例（整个进程只能有一个）
+    MongoOptions options;
+    mongocxx::pool pool;           // 客户端连接池
+
+    // 借出计数与指标
+    std::mutex leaseMutex;
+    std::condition_variable leaseCv;
+    size_t inUse = 0;
+    size_t peakInUse = 0;
+    uint64_t acquisitions = 0;
+    uint64_t timeouts = 0;
+    uint64_t totalWaitNs = 0;
+    uint64_t maxWaitNs = 0;
+    uint64_t totalHoldNs = 0;
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    // 执行阻塞驱动调用的固定线程池，替代每次调用都创建线程的 std::async
+    // 最后声明：先于连接池析构，保证执行中的任务还能归还客户端
+    ThreadPool executor;
+
+    static const char* databaseName() { return "userdb"; }
+
+    // 在 URI 中加入 maxPoolSize，让驱动的池与本类的借出上限一致
+    static std::string poolUri(const MongoOptions& options) {
+        std::string uri = options.uri;
+        if (uri.find('?') != std::string::npos) {
+            uri += "&";  // 已有其它参数
+        } else if (!uri.empty() && uri.back() == '/') {
+            uri += "?";  // mongodb://host:port/
+        } else {
+            uri += "/?"; // mongodb://host:port
+        }
+        uri += "maxPoolSize=" + std::to_string(options.poolSize);
+        return uri;
+    }
+
+    // 借到客户端后调用 fn(database)，返回 fn 的结果；归还在析构中完成，异常时也不会泄漏
+    template <class F>
+    auto withClient(F&& fn) -> decltype(fn(std::declval<mongocxx::database&>())) {
+        auto waitStart = std::chrono::steady_clock::now();
+        {
+            std::unique_lock<std::mutex> lock(leaseMutex);
+            if (!leaseCv.wait_for(lock, options.waitTimeout, [this] { return inUse < options.poolSize; })) {
+                ++timeouts;
+                throw std::runtime_error("MongoDB pool wait timeout");
+            }
+            ++inUse;
+            peakInUse = std::max(peakInUse, inUse);
+            uint64_t waitNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - waitStart).count();
+            ++acquisitions;
+            totalWaitNs += waitNs;
+            maxWaitNs = std::max(maxWaitNs, waitNs);
+        }
+
+        // 归还名额：在客户端 entry 析构（归还给驱动的池）之后执行
+        struct Lease {
+            Database* self;
+            std::chrono::steady_clock::time_point start;
+            ~Lease() {
+                uint64_t holdNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+                {
+                    std::lock_guard<std::mutex> lock(self->leaseMutex);
+                    --self->inUse;
+                    self->totalHoldNs += holdNs;
+                }
+                self->leaseCv.notify_one();
+            }
+        } lease{this, std::chrono::steady_clock::now()};
+
+        auto client = pool.acquire(); // 名额已保证不超过 maxPoolSize，这里不会阻塞
+        mongocxx::database db = (*client)[databaseName()];
+        return fn(db);
+    }
+
+    // 把阻塞的驱动调用放到执行器上，队列已满时返回一个带异常的 future（get() 时抛出）
+    // 借客户端超时等异常同样通过 future 传给调用方
+    template <class F>
+    std::future<bool> submit(F&& fn) {
+        try {
+            return executor.enqueue(std::forward<F>(fn));
+        } catch (const std::exception& e) {
+            LOG_ERROR("MongoDB executor: %s", e.what());
+            std::promise<bool> failed;
+            failed.set_exception(std::current_exception());
+            return failed.get_future();
+        }
+    }
 
 public:
     // 构造函数
-    Database(const std::string& uri) {
+    explicit Database(const MongoOptions& opts)
+        : options(opts),
+          pool(mongocxx::uri{poolUri(opts)}),
+          executor(opts.executorThreads ? opts.executorThreads : opts.poolSize, opts.executorQueue) {
         LOG_INFO("Connecting to MongoDB");
-        std::cout << "Connecting to MongoDB at: " << uri << std::endl;
-        client = mongocxx::client{mongocxx::uri{uri}};
-        db = client["userdb"]; // 使用 userdb 数据库
+        std::cout << "Connecting to MongoDB at: " << opts.uri << " (pool size " << opts.poolSize << ")" << std::endl;
     }
 
-    // 异步注册用户
+    // 异步注册用户：在固定的执行器上执行
     std::future<bool> registerUserAsync(const std::string& username, const std::string& password) {
-        return std::async(std::launch::async, [this, username, password]() {
+        return submit([this, username, password]() {
             return this->registerUser(username, password);
         });
     }
 
-    // 异步登录用户
+    // 异步登录用户：在固定的执行器上执行
     std::future<bool> loginUserAsync(const std::string& username, const std::string& password) {
-        return std::async(std::launch::async, [this, username, password]() {
+        return submit([this, username, password]() {
             return this->loginUser(username, password);
         });
     }
 
     // 注册用户
     bool registerUser(const std::string& username, const std::string& password) {
-        std::cout << "registerUser begin" << std::endl; // 调试信息
         LOG_INFO("User Register");
         bsoncxx::builder::stream::document document{};
         document << "username" << username << "password" << password;
 
-        auto collection = db["users"];
-        bsoncxx::stdx::optional<mongocxx::result::insert_one> result = collection.insert_one(document.view());
-
-        return result ? true : false;
+        return withClient([&](mongocxx::database& db) {
+            auto collection = db["users"];
+            bsoncxx::stdx::optional<mongocxx::result::insert_one> result = collection.insert_one(document.view());
+            return result ? true : false;
+        });
     }
 
     // 登录用户
     bool loginUser(const std::string& username, const std::string& password) {
         LOG_INFO("User Login");
-        auto collection = db["users"];
         bsoncxx::builder::stream::document document{};
         document << "username" << username;
 
-        auto cursor = collection.find(document.view());
-        for (auto&& doc : cursor) {
-            std::string stored_password = doc["password"].get_utf8().value.to_string();
-            if (password == stored_password) {
-                return true;
+        return withClient([&](mongocxx::database& db) {
+            auto collection = db["users"];
+            auto cursor = collection.find(document.view());
+            for (auto&& doc : cursor) {
+                std::string stored_password = doc["password"].get_utf8().value.to_string();
+                if (password == stored_password) {
+                    return true;
+                }
             }
-        }
-        return false;
+            return false;
+        });
     }
 
      // 存储图片信息
-    bool storeImage(const std::string& imageName, const std::string& imagePath, const std::string& description) {
+    // digest 为内容的 SHA-256，相同内容的图片共享同一份文件
+    // insertedId 不为空时写入新文档的 _id（24 位 hex）
+    bool storeImage(const std::string& imageName, const std::string& imagePath, const std::string& description,
+                    const std::string& digest, std::string* insertedId = nullptr) {
         bsoncxx::builder::stream::document document{};
         document << "name" << imageName
                  << "path" << imagePath
-                 << "description" << description;
+                 << "description" << description
+                 << "digest" << digest;
 
-        auto collection = db["images"];
-        bsoncxx::stdx::optional<mongocxx::result::insert_one> result = collection.insert_one(document.view());
-        return result ? true : false;
+        return withClient([&](mongocxx::database& db) {
+            auto collection = db["images"];
+            bsoncxx::stdx::optional<mongocxx::result::insert_one> result = collection.insert_one(document.view());
+            if (result && insertedId && result->inserted_id().type() == bsoncxx::type::k_oid) {
+                *insertedId = result->inserted_id().get_oid().value.to_string();
+            }
+            return result ? true : false;
+        });
     }
 
-    // 获取图片列表
-    std::vector<std::string> getImageList() {
-        std::vector<std::string> images;
-        auto collection = db["images"];
-        auto cursor = collection.find({});
-        for (auto&& doc : cursor) {
-            images.push_back(doc["path"].get_utf8().value.to_string());
+    // 按 _id 升序分页读取图片：after 为上一页最后一个 _id（24 位 hex，空表示从头开始），最多 limit 条
+    // 只取 _id 和 path 两个字段；排序和范围条件都走 _id 上的默认索引，翻页代价与总图片数无关
+    // 每读到一条就调用 onImage(id, path)，由调用方直接序列化，不先收集整页结果
+    // after 格式错误时抛出 std::invalid_argument
+    size_t forEachImage(const std::string& after, size_t limit,
+                        const std::function<void(const std::string&, const std::string&)>& onImage) {
+        bsoncxx::builder::stream::document filter{};
+        if (!after.empty()) {
+            if (after.size() != 24 || after.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+                throw std::invalid_argument("invalid cursor");
+            }
+            filter << "_id" << bsoncxx::builder::stream::open_document
+                   << "$gt" << bsoncxx::oid(after)
+                   << bsoncxx::builder::stream::close_document;
         }
-        return images;
+        bsoncxx::builder::stream::document projection{};
+        projection << "path" << 1;
+        bsoncxx::builder::stream::document sort{};
+        sort << "_id" << 1;
+
+        mongocxx::options::find options;
+        options.projection(projection.view());
+        options.sort(sort.view());
+        options.limit(static_cast<int64_t>(limit));
+
+        return withClient([&](mongocxx::database& db) {
+            size_t count = 0;
+            auto collection = db["images"];
+            auto cursor = collection.find(filter.view(), options);
+            for (auto&& doc : cursor) {
+                onImage(doc["_id"].get_oid().value.to_string(), doc["path"].get_utf8().value.to_string());
+                ++count;
+            }
+            return count;
+        });
+    }
+
+    // 连接池指标
+    MongoPoolStats getPoolStats() {
+        std::lock_guard<std::mutex> lock(leaseMutex);
+        MongoPoolStats stats;
+        stats.poolSize = options.poolSize;
+        stats.inUse = inUse;
+        stats.peakInUse = peakInUse;
+        stats.acquisitions = acquisitions;
+        stats.timeouts = timeouts;
+        stats.avgWaitUs = acquisitions ? totalWaitNs / 1000.0 / acquisitions : 0;
+        stats.maxWaitUs = maxWaitNs / 1000.0;
+        double elapsedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count();
+        stats.utilization = elapsedNs > 0 ? totalHoldNs / (elapsedNs * options.poolSize) : 0;
+        return stats;
     }
 };
 
@@ -95,6 +95,15 @@ public:
         return "";
     }
 
+    // 获取查询参数，例如 /images?limit=20 中的 limit；不存在时返回空字符串
+    std::string getQueryParam(const std::string& name) const {
+        auto it = queryParams.find(name);
+        if (it != queryParams.end()) {
+            return it->second;
+        }
+        return "";
+    }
+
     // 新增一个方法用于获取文件名
     std::string getFileName(const std::string& fieldName) const {
         auto it = fileNames.find(fieldName);
@@ -114,10 +123,29 @@ private:
         else method = UNKNOWN;
         iss >> path;
         iss >> version;
+        // 拆出查询串：路由只按路径匹配，参数通过 getQueryParam 读取
+        size_t question = path.find('?');
+        if (question != std::string::npos) {
+            parseQueryString(path.substr(question + 1));
+            path.erase(question);
+        }
         state = HEADERS;
         return true;
     }
 
+    void parseQueryString(const std::string& query) {
+        std::istringstream stream(query);
+        std::string pair;
+        while (std::getline(stream, pair, '&')) {
+            std::size_t pos = pair.find('=');
+            if (pos == std::string::npos) {
+                queryParams[pair] = "";
+            } else {
+                queryParams[pair.substr(0, pos)] = pair.substr(pos + 1);
+            }
+        }
+    }
+
     bool parseHeader(const std::string& line) {
         size_t pos = line.find(": ");
         if (pos == std::string::npos) return false;
@@ -200,6 +228,7 @@ private:
     std::string path;
     std::string version;
     std::unordered_map<std::string, std::string> headers;
+    std::unordered_map<std::string, std::string> queryParams; // 查询串参数
     ParseState state;
     std::string body;
 
@@ -46,6 +46,7 @@ private:
         switch (statusCode) {
             case 200: return "OK";
             case 404: return "Not Found";
+            case 503: return "Service Unavailable";
             // ... 其他状态码 ...
             default: return "Unknown";
         }
@@ -150,6 +150,25 @@ void readData(int fd) {
 
         router.setupDatabaseRoutes(db);
         router.setupImageRoutes(db); 
+
+        // MongoDB 连接池指标：借出数、等待时间、超时次数和利用率
+        router.addRoute("GET", "/metrics", [this](const HttpRequest& req) {
+            MongoPoolStats stats = db.getPoolStats();
+            std::ostringstream oss;
+            oss << "mongo_pool_size " << stats.poolSize << "\n"
+                << "mongo_pool_in_use " << stats.inUse << "\n"
+                << "mongo_pool_peak_in_use " << stats.peakInUse << "\n"
+                << "mongo_pool_acquisitions " << stats.acquisitions << "\n"
+                << "mongo_pool_timeouts " << stats.timeouts << "\n"
+                << "mongo_pool_wait_avg_us " << stats.avgWaitUs << "\n"
+                << "mongo_pool_wait_max_us " << stats.maxWaitUs << "\n"
+                << "mongo_pool_utilization " << stats.utilization << "\n";
+            HttpResponse response;
+            response.setStatusCode(200);
+            response.setHeader("Content-Type", "text/plain");
+            response.setBody(oss.str());
+            return response;
+        });
         // ... 添加更多路由 ...
 
     }
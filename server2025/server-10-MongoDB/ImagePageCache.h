@@ -0,0 +1,94 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+// /images 分页结果缓存：key 为 "after|limit"，value 为序列化好的 JSON
+// 分页按 _id 升序。ObjectId 由客户端在 insert_one 之前生成，多个工作线程的插入提交顺序不固定，
+// 新图片的 _id 不一定比已有的都大，可能落进某个满页的范围
+// 所以每个满页记下它覆盖的 _id 范围 (after, last]，上传时丢掉不满的尾页和范围包含新 _id 的满页，其余满页保留
+class ImagePageCache {
+public:
+    explicit ImagePageCache(size_t capacity = 256) : capacity_(capacity) {}
+
+    bool get(const std::string& key, std::string& body) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            return false;
+        }
+        entries_.splice(entries_.begin(), entries_, it->second); // 移到 LRU 头部
+        body = it->second->body;
+        return true;
+    }
+
+    // 查询数据库之前取得的版本号
+    uint64_t generation() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return generation_;
+    }
+
+    // after: 本页的游标；last: 本页最后一个 _id；full: 本页是否是满页（后面还有数据）
+    // 查询期间有上传发生（版本号变化）时不缓存：查询可能没看到那张图片，而它的失效已经执行过了（满页也一样）
+    void put(const std::string& key, const std::string& after, const std::string& last, std::string body,
+             bool full, uint64_t generationBeforeQuery) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (generation_ != generationBeforeQuery) {
+            return;
+        }
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            entries_.erase(it->second);
+            index_.erase(it);
+        }
+        entries_.push_front(Entry{key, std::move(body), full, toLower(after), toLower(last)});
+        index_[key] = entries_.begin();
+        if (entries_.size() > capacity_) {
+            index_.erase(entries_.back().key);
+            entries_.pop_back();
+        }
+    }
+
+    // 有新图片上传（插入已经提交）：丢掉所有不满的页（包括空页），以及范围包含 newId 的满页
+    // newId 为空（插入结果未知）时全部丢掉
+    void invalidate(const std::string& newId) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++generation_;
+        std::string id = toLower(newId);
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            // 24 位小写 hex 按字符串比较与按 ObjectId 比较的结果相同
+            bool covers = id.empty() || (it->after < id && id <= it->last);
+            if (!it->full || covers) {
+                index_.erase(it->key);
+                it = entries_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        std::string body;
+        bool full;
+        std::string after; // 本页覆盖的 _id 范围 (after, last]，小写
+        std::string last;
+    };
+
+    static std::string toLower(std::string s) {
+        std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return std::tolower(c); });
+        return s;
+    }
+
+    size_t capacity_;
+    uint64_t generation_ = 0; // 每次上传加一
+    std::mutex mutex_;
+    std::list<Entry> entries_; // 头部为最近使用
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+};
@@ -1,11 +1,15 @@
 #include "HttpRequest.h"
 #include "HttpResponse.h"
 #include "Database.h"
+#include "ImagePageCache.h"
+#include "BlobStore.h"
+#include <algorithm>
+#include <cstdlib>
 #include <functional>
+#include <memory>
 #include <unordered_map>
 #include <future>
-#include <sys/stat.h>  // 包含 mkdir 函数的声明
-#include <cerrno>      // 包含 errno 的声明
+#include <stdexcept>
 
 
 class Router {
@@ -31,12 +35,16 @@ public:
             auto params = req.parseFormBody(); 
             std::string username = params["username"];
             std::string password = params["password"];
-            // 异步调用数据库注册方法
-            if (db.registerUser(username, password)) {
-                return HttpResponse::makeOkResponse("Register Success!");
-            } else {
-                return HttpResponse::makeErrorResponse(400, "Register Failed!");
+            // 在数据库执行器上调用驱动；执行器队列已满或借客户端超时时返回 503
+            try {
+                if (db.registerUserAsync(username, password).get()) {
+                    return HttpResponse::makeOkResponse("Register Success!");
+                }
+            } catch (const std::exception& e) {
+                LOG_ERROR("Register failed: %s", e.what());
+                return HttpResponse::makeErrorResponse(503, "Service Unavailable");
             }
+            return HttpResponse::makeErrorResponse(400, "Register Failed!");
         });
 
         // 登录路由
@@ -44,88 +52,169 @@ public:
             auto params = req.parseFormBody();
             std::string username = params["username"];
             std::string password = params["password"];
-            // 异步调用数据库登录方法
-            if (db.loginUser(username, password)){
-                return HttpResponse::makeOkResponse("Login Success!");
-            } else {
-                return HttpResponse::makeErrorResponse(400, "Login Failed!");
+            // 在数据库执行器上调用驱动；执行器队列已满或借客户端超时时返回 503
+            try {
+                if (db.loginUserAsync(username, password).get()) {
+                    return HttpResponse::makeOkResponse("Login Success!");
+                }
+            } catch (const std::exception& e) {
+                LOG_ERROR("Login failed: %s", e.what());
+                return HttpResponse::makeErrorResponse(503, "Service Unavailable");
             }
+            return HttpResponse::makeErrorResponse(400, "Login Failed!");
         });
     }
 
 void setupImageRoutes(Database& db) {
+        // 图片目录不存在时自动创建，启动时重建文件名索引
+        imageBlobs = std::make_unique<BlobStore>("images");
+
         // 图片上传路由
-       addRoute("POST", "/upload", [&db](const HttpRequest& req) {
+       addRoute("POST", "/upload", [this, &db](const HttpRequest& req) {
         // 获取表单字段
+        // 带 digest 字段且没有文件时按摘要引用已有内容（客户端已知 SHA-256 时不用上传数据）
         std::string fileContent = req.getFileContent("file");
         std::string fileName = req.getFileName("file");  // 使用新方法获取文件名
         std::string description = req.getFormField("description");
-
-        // 检查并创建目录
-        std::string dirPath = "images/";
-        try {
-            if (mkdir(dirPath.c_str(), 0777) == -1 && errno != EEXIST) {
-                LOG_ERROR("Failed to create directory: %s", dirPath.c_str());
-                return HttpResponse::makeErrorResponse(500, "Internal Server Error: Unable to create directory");
-            }
-        } catch (const std::exception& e) {
-            LOG_ERROR("Exception while creating directory: %s, error: %s", dirPath.c_str(), e.what());
-            return HttpResponse::makeErrorResponse(500, "Internal Server Error: Exception while creating directory");
+        std::string digest = req.getFormField("digest");
+        if (fileName.empty()) {
+            fileName = req.getFormField("filename");
+        }
+        if (!BlobStore::isValidName(fileName)) {
+            return HttpResponse::makeErrorResponse(400, "Invalid file name");
         }
 
-        // 保存文件到服务器的某个路径
-        std::string filePath = dirPath + fileName;
+        // 按内容保存：相同内容只在存储中写一次，文件名是从存储复制（能 reflink 时共享数据块）出来的独立文件
+        std::string filePath = imageBlobs->pathOf(fileName);
+        BlobStore::Blob blob;
         try {
-            std::ofstream file(filePath, std::ios::binary);
-            if (!file.is_open()) {
-                LOG_ERROR("Failed to open file for writing: %s", filePath.c_str());
-                return HttpResponse::makeErrorResponse(500, "Internal Server Error: Unable to save file");
+            if (!fileContent.empty() || digest.empty()) {
+                auto result = imageBlobs->put(fileName, fileContent);
+                blob = result.blob;
+                LOG_INFO("File saved: %s -> %s%s", filePath.c_str(), blob.digest.c_str(),
+                         result.deduplicated ? " (deduplicated)" : "");
+            } else if (!BlobStore::isValidDigest(digest) || !imageBlobs->link(fileName, digest, blob)) {
+                return HttpResponse::makeErrorResponse(404, "Unknown digest");
             }
-            file.write(fileContent.c_str(), fileContent.size());
-            file.close();
-            LOG_INFO("File saved successfully: %s", filePath.c_str());
         } catch (const std::exception& e) {
             LOG_ERROR("Exception while saving file: %s, error: %s", filePath.c_str(), e.what());
             return HttpResponse::makeErrorResponse(500, "Internal Server Error: Exception while saving file");
         }
 
         // 将图片信息存入数据库
+        std::string imageId;
         try {
-            if (!db.storeImage(fileName, filePath, description)) {
+            if (!db.storeImage(fileName, filePath, description, blob.digest, &imageId)) {
                 LOG_ERROR("Failed to store image info in database for: %s", fileName.c_str());
                 return HttpResponse::makeErrorResponse(500, "Internal Server Error: Unable to store image info");
             }
         } catch (const std::exception& e) {
             LOG_ERROR("Exception while storing image info in database for: %s, error: %s", fileName.c_str(), e.what());
+            imagePages.invalidate(""); // 插入可能已经生效（例如写确认超时），不知道 _id 时丢掉全部缓存
             return HttpResponse::makeErrorResponse(500, "Internal Server Error: Exception while storing image info");
         }
 
+        imagePages.invalidate(imageId); // 尾页和范围包含新 _id 的满页
+
         LOG_INFO("Image uploaded successfully: %s", fileName.c_str());
-        return HttpResponse::makeOkResponse("Image uploaded successfully");
+        HttpResponse response = HttpResponse::makeOkResponse("Image uploaded successfully");
+        response.setHeader("ETag", "\"" + blob.digest + "\"");
+        return response;
     });
 
 
-        // 获取图片列表路由
-        addRoute("GET", "/images", [&db](const HttpRequest& req) {
-            std::vector<std::string> imageList = db.getImageList();
-            std::stringstream ss;
-            ss << "[";
-            for (size_t i = 0; i < imageList.size(); ++i) {
-                ss << "\"" << imageList[i] << "\"";
-                if (i < imageList.size() - 1) {
-                    ss << ", ";
+        // 获取图片列表路由（分页）：GET /images?limit=50&after=<上一页返回的 next>
+        // 返回 {"images":[{"id":"...","path":"..."}],"next":"..."}，next 为空表示没有下一页
+        addRoute("GET", "/images", [this, &db](const HttpRequest& req) {
+            std::string after = req.getQueryParam("after");
+            size_t limit = kDefaultPageSize;
+            std::string limitParam = req.getQueryParam("limit");
+            if (!limitParam.empty()) {
+                limit = std::strtoul(limitParam.c_str(), nullptr, 10);
+                if (limit == 0) {
+                    return HttpResponse::makeErrorResponse(400, "Invalid limit");
                 }
+                limit = std::min(limit, kMaxPageSize);
             }
-            ss << "]";
 
             HttpResponse response;
             response.setStatusCode(200);
             response.setHeader("Content-Type", "application/json");
-            response.setBody(ss.str());
+
+            std::string key = after + "|" + std::to_string(limit);
+            std::string body;
+            if (imagePages.get(key, body)) {
+                response.setBody(body);
+                return response;
+            }
+
+            // 多取一条用来判断是否还有下一页
+            uint64_t generation = imagePages.generation();
+            std::string lastId;
+            size_t count = 0;
+            body.reserve(64 + limit * 96);
+            body += "{\"images\":[";
+            try {
+                db.forEachImage(after, limit + 1, [&](const std::string& id, const std::string& path) {
+                    if (++count > limit) {
+                        return;
+                    }
+                    if (count > 1) {
+                        body += ',';
+                    }
+                    body += "{\"id\":\"";
+                    body += id;
+                    body += "\",\"path\":\"";
+                    appendJsonEscaped(body, path);
+                    body += "\"}";
+                    lastId = id;
+                });
+            } catch (const std::invalid_argument&) {
+                return HttpResponse::makeErrorResponse(400, "Invalid cursor");
+            } catch (const std::exception& e) {
+                LOG_ERROR("Failed to list images: %s", e.what());
+                return HttpResponse::makeErrorResponse(500, "Internal Server Error");
+            }
+            bool full = count > limit;
+            body += "],\"next\":\"";
+            if (full) {
+                body += lastId;
+            }
+            body += "\"}";
+
+            imagePages.put(key, after, lastId, body, full, generation);
+            response.setBody(body);
             return response;
         });
     }
 
 private:
+    static constexpr size_t kDefaultPageSize = 50;
+    static constexpr size_t kMaxPageSize = 500;
+
     std::unordered_map<std::string, HandlerFunc> routes;
+    ImagePageCache imagePages; // /images 分页结果缓存
+    std::unique_ptr<BlobStore> imageBlobs; // 上传图片的内容存储
+
+    // 把字符串按 JSON 规则转义后追加到 out
+    static void appendJsonEscaped(std::string& out, const std::string& value) {
+        for (char c : value) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        static const char kDigits[] = "0123456789abcdef";
+                        out += "\\u00";
+                        out += kDigits[(c >> 4) & 0x0f];
+                        out += kDigits[c & 0x0f];
+                    } else {
+                        out += c;
+                    }
+            }
+        }
+    }
 };
@@ -1,4 +1,7 @@
+#pragma once
 #include <vector>
+#include <cstdint>
+#include <stdexcept>
 #include <queue>
 #include <thread>
 #include <mutex>
@@ -8,7 +11,8 @@
 
 class ThreadPool {
 public:
-    ThreadPool(size_t threads) : stop(false) {
+    // maxQueueSize: 队列上限，超过时 enqueue 抛出异常；默认不限制
+    ThreadPool(size_t threads, size_t maxQueueSize = SIZE_MAX) : stop(false), maxQueueSize(maxQueueSize) {
         for(size_t i = 0; i < threads; ++i) {
             workers.emplace_back([this] {
                 while(true) {
@@ -37,6 +41,7 @@ public:
         {
             std::unique_lock<std::mutex> lock(queue_mutex);
             if(stop) throw std::runtime_error("enqueue on stopped ThreadPool");
+            if(tasks.size() >= maxQueueSize) throw std::runtime_error("enqueue failed: ThreadPool queue is full");
             tasks.emplace([task](){ (*task)(); });
         }
         condition.notify_one();
@@ -60,4 +65,5 @@ private:
     std::mutex queue_mutex;
     std::condition_variable condition;
     bool stop;
+    size_t maxQueueSize; // 最大队列长度
 };
@@ -1,13 +1,28 @@
-
 #include "HttpServer.h"
 #include "Database.h"
+#include <cstdlib>
 
 int main(int argc, char* argv[]) {
     int port = 8080; // 默认端口
     if (argc > 1) {
         port = std::stoi(argv[1]); // 从命令行获取端口
     }
-    Database db("mongodb://172.20.0.2:27017"); // 初始化数据库，这里要根据你mongo的实际IP修改
+
+    // MongoDB 连接配置，可以用环境变量覆盖：
+    // MONGO_URI、MONGO_POOL_SIZE（客户端数量）、MONGO_WAIT_MS（借客户端的最长等待时间）
+    MongoOptions mongo;
+    mongo.uri = "mongodb://172.20.0.2:27017"; // 这里要根据你mongo的实际IP修改
+    if (const char* uri = std::getenv("MONGO_URI")) {
+        mongo.uri = uri;
+    }
+    if (const char* size = std::getenv("MONGO_POOL_SIZE")) {
+        mongo.poolSize = std::max(1, std::atoi(size));
+    }
+    if (const char* wait = std::getenv("MONGO_WAIT_MS")) {
+        mongo.waitTimeout = std::chrono::milliseconds(std::atoi(wait));
+    }
+
+    Database db(mongo); // 初始化数据库
     HttpServer server(port, 10, db);
     server.setupRoutes();
     server.start();
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+
+// 访问日志格式
+enum class AccessLogFormat {
+    Combined,   // nginx/Apache combined 格式，末尾追加耗时和连接复用次数
+    JsonLines   // 每行一个 JSON 对象，方便日志系统直接解析
+};
+
+// 访问日志配置
+struct AccessLogOptions {
+    bool enabled = true;
+    std::string path = "access.log";
+    AccessLogFormat format = AccessLogFormat::Combined;
+    uint32_t sampleEvery = 1;                      // 每 N 个请求记录 1 个，1 表示全部记录
+    bool alwaysLogErrors = true;                   // 状态码 >= 500 的请求不受采样影响
+    size_t capacity = 8192;                        // 缓冲区可容纳的记录数（2 的幂），满时丢弃并计数
+    std::chrono::milliseconds flushInterval{200};  // 后台线程批量写入的间隔
+};
+
+// 一次请求的访问记录，定长，直接放进环形缓冲区
+struct AccessRecord {
+    int64_t timeNs = 0;       // 请求开始处理的墙上时间
+    char method[8] = {0};
+    char path[128] = {0};     // 超长路径被截断
+    char peer[48] = {0};      // 对端地址 ip:port
+    char referer[96] = {0};
+    char userAgent[96] = {0};
+    uint16_t status = 0;
+    uint32_t bytes = 0;       // 发送的响应字节数
+    uint32_t queueUs = 0;     // 在线程池队列中等待的时间
+    uint32_t readUs = 0;      // 读取请求（SSL_read）
+    uint32_t handlerUs = 0;   // 解析请求和路由处理
+    uint32_t writeUs = 0;     // 发送响应（SSL_write）
+    uint32_t reuse = 0;       // 该连接之前已经处理过的请求数（keep-alive 复用次数）
+
+    // 把字符串拷贝进定长字段，超长截断
+    template <size_t N>
+    static void copyField(char (&field)[N], const std::string& value) {
+        size_t n = value.size() < N - 1 ? value.size() : N - 1;
+        memcpy(field, value.data(), n);
+        field[n] = 0;
+    }
+};
+
+// 访问日志：与错误日志 Logger 完全分开
+// 工作线程把定长记录放进一个多生产者单消费者的有界无锁队列（Vyukov 序号数组），后台线程批量格式化并一次 write 写出
+class AccessLog {
+public:
+    explicit AccessLog(const AccessLogOptions& options = AccessLogOptions())
+        : options(options), slots(nullptr), mask(0), fd(-1) {
+        if (!options.enabled) return;
+        size_t capacity = 1;
+        while (capacity < options.capacity) capacity <<= 1;
+        slots.reset(new Slot[capacity]);
+        for (size_t i = 0; i < capacity; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        mask = capacity - 1;
+        fd = ::open(options.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        flusher = std::thread([this]() { flushLoop(); });
+    }
+
+    ~AccessLog() {
+        if (!flusher.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopping = true;
+        }
+        wakeCond.notify_one();
+        flusher.join();
+        drain(); // 写出剩余记录
+        if (fd >= 0) close(fd);
+    }
+
+    AccessLog(const AccessLog&) = delete;
+    AccessLog& operator=(const AccessLog&) = delete;
+
+    // 是否需要记录这个请求：先判断采样，未被采样的请求不必填充记录
+    bool wants(uint16_t status) {
+        if (!slots) return false;
+        if (options.alwaysLogErrors && status >= 500) return true;
+        if (options.sampleEvery <= 1) return true;
+        thread_local uint32_t counter = 0;
+        return ++counter % options.sampleEvery == 0;
+    }
+
+    // 放入一条记录，队列满时丢弃；只有几次原子操作和一次拷贝，不做格式化和 I/O
+    void record(const AccessRecord& record) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[pos & mask];
+            size_t seq = slot->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed); // 队列已满
+                return;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        slot->record = record;
+        slot->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        AccessRecord record;
+    };
+
+    AccessLogOptions options;
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) size_t dequeuePos = 0;             // 只有后台线程访问
+    std::atomic<uint64_t> dropped{0};
+    uint64_t reportedDropped = 0;
+    int fd;
+    std::thread flusher;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCond;
+    bool stopping = false;
+    std::string batch;                             // 批量写入缓冲
+    time_t cachedSecond = -1;                      // 同一秒内的时间字符串只格式化一次
+    char cachedTime[40] = {0};
+
+    void flushLoop() {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        while (!stopping) {
+            wakeCond.wait_for(lock, options.flushInterval, [this]() { return stopping; });
+            lock.unlock();
+            drain();
+            lock.lock();
+        }
+    }
+
+    // 取出队列中所有已提交的记录，格式化后一次写出
+    void drain() {
+        batch.clear();
+        while (true) {
+            Slot& slot = slots[dequeuePos & mask];
+            size_t seq = slot.sequence.load(std::memory_order_acquire);
+            if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(dequeuePos + 1) < 0) break; // 没有更多记录
+            format(slot.record);
+            slot.sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+            ++dequeuePos;
+            if (batch.size() >= 256 * 1024) writeBatch();
+        }
+        uint64_t total = dropped.load(std::memory_order_relaxed);
+        if (total != reportedDropped) {
+            // 在访问日志中留下丢弃记录，避免统计时误以为流量下降
+            char line[96];
+            snprintf(line, sizeof(line), "# access log dropped %llu records (total %llu)\n",
+                     static_cast<unsigned long long>(total - reportedDropped),
+                     static_cast<unsigned long long>(total));
+            batch += line;
+            reportedDropped = total;
+        }
+        writeBatch();
+    }
+
+    void writeBatch() {
+        size_t off = 0;
+        while (fd >= 0 && off < batch.size()) {
+            ssize_t n = ::write(fd, batch.data() + off, batch.size() - off);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                break; // 磁盘满等错误：放弃本批
+            }
+            off += static_cast<size_t>(n);
+        }
+        batch.clear();
+    }
+
+    // 字符串字段直接转义追加到 batch，不经过定长缓冲区：记录再长也不会被截断，每条一定以 '\n' 结尾
+    // 来自客户端的字段（方法、路径、Referer、User-Agent）都要转义，否则可以伪造字段或换行
+    void format(const AccessRecord& r) {
+        time_t seconds = static_cast<time_t>(r.timeNs / 1000000000);
+        uint32_t totalUs = r.queueUs + r.readUs + r.handlerUs + r.writeUs;
+        char num[256]; // 只放时间和数字字段，长度有上限
+        if (options.format == AccessLogFormat::JsonLines) {
+            if (seconds != cachedSecond) {
+                struct tm tm;
+                gmtime_r(&seconds, &tm);
+                strftime(cachedTime, sizeof(cachedTime), "%Y-%m-%dT%H:%M:%S", &tm);
+                cachedSecond = seconds;
+            }
+            snprintf(num, sizeof(num), "{\"time\":\"%s.%06ldZ\",\"peer\":\"",
+                     cachedTime, static_cast<long>(r.timeNs % 1000000000 / 1000));
+            batch += num;
+            appendJsonEscaped(r.peer);
+            batch += "\",\"method\":\"";
+            appendJsonEscaped(r.method);
+            batch += "\",\"path\":\"";
+            appendJsonEscaped(r.path);
+            snprintf(num, sizeof(num),
+                     "\",\"status\":%u,\"bytes\":%u,\"queue_us\":%u,\"read_us\":%u,\"handler_us\":%u,"
+                     "\"write_us\":%u,\"total_us\":%u,\"reuse\":%u,\"referer\":\"",
+                     r.status, r.bytes, r.queueUs, r.readUs, r.handlerUs, r.writeUs, totalUs, r.reuse);
+            batch += num;
+            appendJsonEscaped(r.referer);
+            batch += "\",\"user_agent\":\"";
+            appendJsonEscaped(r.userAgent);
+            batch += "\"}\n";
+        } else {
+            if (seconds != cachedSecond) {
+                struct tm tm;
+                localtime_r(&seconds, &tm);
+                strftime(cachedTime, sizeof(cachedTime), "%d/%b/%Y:%H:%M:%S %z", &tm);
+                cachedSecond = seconds;
+            }
+            // combined 格式 + 耗时（秒）与各阶段耗时（微秒）
+            appendCombinedEscaped(r.peer);
+            batch += " - - [";
+            batch += cachedTime;
+            batch += "] \"";
+            appendCombinedEscaped(r.method);
+            batch += ' ';
+            appendCombinedEscaped(r.path);
+            snprintf(num, sizeof(num), " HTTP/1.1\" %u %u \"", r.status, r.bytes);
+            batch += num;
+            appendCombinedEscaped(r.referer[0] ? r.referer : "-");
+            batch += "\" \"";
+            appendCombinedEscaped(r.userAgent[0] ? r.userAgent : "-");
+            snprintf(num, sizeof(num), "\" rt=%.6f q=%u r=%u h=%u w=%u reuse=%u\n",
+                     totalUs / 1e6, r.queueUs, r.readUs, r.handlerUs, r.writeUs, r.reuse);
+            batch += num;
+        }
+    }
+
+    void appendJsonEscaped(const char* s) {
+        for (; *s; ++s) {
+            unsigned char c = static_cast<unsigned char>(*s);
+            if (c == '"' || c == '\\') {
+                batch += '\\';
+                batch += static_cast<char>(c);
+            } else if (c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                batch += buf;
+            } else {
+                batch += static_cast<char>(c);
+            }
+        }
+    }
+
+    // 与 nginx 的 access_log 相同：'"'、'\'、控制字符和非 ASCII 字节写成 \xHH
+    void appendCombinedEscaped(const char* s) {
+        static const char kDigits[] = "0123456789ABCDEF";
+        for (; *s; ++s) {
+            unsigned char c = static_cast<unsigned char>(*s);
+            if (c == '"' || c == '\\' || c < 0x20 || c >= 0x7f) {
+                batch += "\\x";
+                batch += kDigits[c >> 4];
+                batch += kDigits[c & 0x0f];
+            } else {
+                batch += static_cast<char>(c);
+            }
+        }
+    }
+};
@@ -49,7 +49,7 @@ public:
 
     // 解析表单形式的请求体，返回键值对字典
     std::unordered_map<std::string, std::string> parseFormBody() const {
-        LOG_INFO("Form body parsed");
+        LOG_DEBUG("Form body parsed");
         std::unordered_map<std::string, std::string> params;
         if (method != POST) return params;
 
@@ -83,6 +83,15 @@ public:
         return path;
     }
 
+    // 获取请求头的值（去掉行尾的 \r），不存在时返回空字符串
+    std::string getHeader(const std::string& name) const {
+        auto it = headers.find(name);
+        if (it == headers.end()) return "";
+        std::string value = it->second;
+        if (!value.empty() && value.back() == '\r') value.pop_back();
+        return value;
+    }
+
     // 其他成员函数和变量 ...
 
 private:
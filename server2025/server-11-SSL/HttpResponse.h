@@ -14,6 +14,11 @@ public:
         statusCode = code;
     }
 
+    // 获取状态码
+    int getStatusCode() const {
+        return statusCode;
+    }
+
     // 设置响应头
     void setHeader(const std::string& name, const std::string& value) {
         headers[name] = value;
@@ -57,6 +62,8 @@ private:
     std::string getStatusMessage() const {
         switch (statusCode) {
             case 200: return "OK";
+            case 400: return "Bad Request";
+            case 403: return "Forbidden";
             case 404: return "Not Found";
             // ... 其他状态码 ...
             default: return "Unknown";
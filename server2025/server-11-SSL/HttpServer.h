@@ -1,12 +1,18 @@
 // 导入所需的头文件
 #include <openssl/ssl.h>
 #include <openssl/err.h>
+#include <openssl/crypto.h>
 #include "Logger.h" // 自定义的日志记录工具
 #include "ThreadPool.h" // 线程池，用于处理并发请求
 #include "Router.h" // 路由器，用于分发请求到对应的处理函数
 #include "HttpRequest.h" // HTTP请求解析
 #include "HttpResponse.h" // HTTP响应构造
 #include "Database.h" // 数据库操作
+#include "AccessLog.h" // 访问日志
+#include <arpa/inet.h>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
 #include <sys/epoll.h> // 使用epoll实现高效的事件驱动
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -23,8 +29,9 @@
 class HttpServer {
 public:
     // 构造函数，初始化服务器设置，包括端口、事件最大数量和数据库引用
-    HttpServer(int port, int max_events, Database& db)
-        : port(port), max_events(max_events), db(db) {
+    // accessLogOptions: 访问日志的格式、采样和写入方式
+    HttpServer(int port, int max_events, Database& db, const AccessLogOptions& accessLogOptions = AccessLogOptions())
+        : port(port), max_events(max_events), db(db), accessLog(accessLogOptions) {
         SSL_library_init(); // 初始化OpenSSL
         OpenSSL_add_ssl_algorithms(); // 加载SSL算法
         SSL_load_error_strings(); // 加载错误提示字符串
@@ -65,8 +72,8 @@ public:
                 if (events[i].data.fd == server_fd) { // 如果是服务器socket事件，接受新连接
                     acceptConnection();
                 } else { // 否则处理已有连接的读写事件
-                    LOG_INFO("Handling connection for fd: %d", events[i].data.fd);
-                    pool.enqueue([this, fd = events[i].data.fd] { handleConnection(fd); });
+                    LOG_DEBUG("Handling connection for fd: %d", events[i].data.fd);
+                    pool.enqueue([this, fd = events[i].data.fd, queuedNs = steadyNs()] { handleConnection(fd, queuedNs); });
                 }
             }
         }
@@ -81,6 +88,25 @@ public:
             return response;
         });
 
+        // 运行期调整日志级别：POST level=debug[&module=HttpServer]，module 省略时设置全局级别
+        // 只有设置了环境变量 LOG_ADMIN_TOKEN 才开放，请求中需要带上相同的 token
+        const char* adminToken = getenv("LOG_ADMIN_TOKEN");
+        if (adminToken && *adminToken) {
+            std::string token = adminToken;
+            router.addRoute("POST", "/admin/loglevel", [token](const HttpRequest& req) {
+                auto params = req.parseFormBody();
+                if (!constantTimeEquals(params["token"], token)) {
+                    return HttpResponse::makeErrorResponse(403, "Forbidden");
+                }
+                std::string spec = params["module"].empty() ? params["level"] : params["module"] + "=" + params["level"];
+                if (!Logger::configureLevels(spec)) {
+                    return HttpResponse::makeErrorResponse(400, "Bad log level");
+                }
+                LOG_WARNING("Log levels changed to %s", Logger::describeLevels().c_str());
+                return HttpResponse::makeOkResponse(Logger::describeLevels());
+            });
+        }
+
         // 根据需要添加更多路由
         router.setupDatabaseRoutes(db);
         LOG_INFO("Routes setup completed.");  // 添加日志
@@ -92,18 +118,86 @@ private:
     Database& db; // 数据库引用
     SSL_CTX* sslCtx; // SSL上下文
     std::map<int, SSL*> sslMap; // 存储每个连接的SSL对象的映射
+    AccessLog accessLog; // 访问日志，与错误日志分开
+
+    // 每个连接的访问日志信息
+    struct ConnectionInfo {
+        char peer[48];      // 对端地址 ip:port
+        uint32_t requests;  // 已处理的请求数
+    };
+    std::unordered_map<int, ConnectionInfo> connections;
+    std::mutex connMutex; // 保护 sslMap 和 connections：accept 在 epoll 线程，读取在工作线程
+
+    // 比较 token：长度相同时逐字节比较全部内容（CRYPTO_memcmp），耗时与第一个不同字节的位置无关，不能逐字节猜出 token
+    static bool constantTimeEquals(const std::string& a, const std::string& b) {
+        return a.size() == b.size() && CRYPTO_memcmp(a.data(), b.data(), a.size()) == 0;
+    }
+
+    // 一次请求各阶段的时间点（steady_clock 纳秒）
+    struct RequestTiming {
+        int64_t queuedNs;   // 提交到线程池
+        int64_t startNs;    // 工作线程开始处理
+        int64_t readDoneNs; // 读完请求
+    };
+
+    static int64_t steadyNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // 记录新连接的对端地址，fd 被复用时覆盖旧连接的信息
+    void rememberPeer(int fd, const struct sockaddr_in& addr) {
+        ConnectionInfo info = {};
+        char ip[INET_ADDRSTRLEN] = "-";
+        inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+        snprintf(info.peer, sizeof(info.peer), "%s:%u", ip, ntohs(addr.sin_port));
+        std::lock_guard<std::mutex> lock(connMutex);
+        connections[fd] = info;
+    }
+
+    // 写一条访问日志：未被采样的请求直接返回，不做任何拷贝
+    void logAccess(int fd, const HttpRequest& request, int status, int bytes, const RequestTiming& timing,
+                   int64_t handlerDoneNs, int64_t writeDoneNs) {
+        AccessRecord record;
+        {
+            std::lock_guard<std::mutex> lock(connMutex);
+            auto it = connections.find(fd);
+            if (it != connections.end()) {
+                record.reuse = it->second.requests++;
+                memcpy(record.peer, it->second.peer, sizeof(record.peer));
+            }
+        }
+        if (!accessLog.wants(static_cast<uint16_t>(status))) return;
+
+        auto micros = [](int64_t from, int64_t to) { return static_cast<uint32_t>(to > from ? (to - from) / 1000 : 0); };
+        record.timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count() - (writeDoneNs - timing.startNs);
+        AccessRecord::copyField(record.method, request.getMethodString());
+        AccessRecord::copyField(record.path, request.getPath());
+        AccessRecord::copyField(record.referer, request.getHeader("Referer"));
+        AccessRecord::copyField(record.userAgent, request.getHeader("User-Agent"));
+        record.status = static_cast<uint16_t>(status);
+        record.bytes = bytes > 0 ? static_cast<uint32_t>(bytes) : 0;
+        record.queueUs = micros(timing.queuedNs, timing.startNs);
+        record.readUs = micros(timing.startNs, timing.readDoneNs);
+        record.handlerUs = micros(timing.readDoneNs, handlerDoneNs);
+        record.writeUs = micros(handlerDoneNs, writeDoneNs);
+        accessLog.record(record);
+    }
 
     // 添加SSL对象到映射中，用于跟踪每个连接的SSL状态。
     void addSSLToMap(int fd, SSL* ssl) {
+        std::lock_guard<std::mutex> lock(connMutex);
         sslMap[fd] = ssl; // 将文件描述符与其对应的SSL对象关联。
-        LOG_INFO("Added SSL object for fd: %d to map", fd); // 记录日志信息。
+        LOG_DEBUG("Added SSL object for fd: %d to map", fd); // 记录日志信息。
     }
 
     // 从映射中获取指定文件描述符对应的SSL对象。
     SSL* getSSLFromMap(int fd) {
+        std::lock_guard<std::mutex> lock(connMutex);
         auto it = sslMap.find(fd); // 查找指定的文件描述符。
         if (it != sslMap.end()) { // 如果找到了对应的条目，
-            LOG_INFO("Found SSL object for fd: %d in map", fd); // 记录日志信息。
+            LOG_DEBUG("Found SSL object for fd: %d in map", fd); // 记录日志信息。
             return it->second; // 返回找到的SSL对象。
         }
         LOG_ERROR("getSSL object not found for fd: %d in map", fd); // 如果未找到，记录错误日志。
@@ -112,11 +206,13 @@ private:
 
     // 从映射中移除指定文件描述符对应的SSL对象，并释放相关资源。
     void removeSSLFromMap(int fd) {
+        std::lock_guard<std::mutex> lock(connMutex);
+        connections.erase(fd);
         auto it = sslMap.find(fd); // 查找指定的文件描述符。
         if (it != sslMap.end()) { // 如果找到了对应的条目，
             SSL_free(it->second); // 释放对应的SSL对象。
             sslMap.erase(it); // 从映射中移除该条目。
-            LOG_INFO("Removed SSL object for fd: %d from map", fd); // 记录日志信息。
+            LOG_DEBUG("Removed SSL object for fd: %d from map", fd); // 记录日志信息。
         }
     }
 
@@ -178,12 +274,12 @@ private:
             close(client_fd); // 关闭客户端连接。
         } else {
             addSSLToMap(client_fd, ssl); // 将SSL对象与客户端连接关联。
-            LOG_INFO("Added new client to epoll and ssl map"); // 记录日志信息。
+            LOG_DEBUG("Added new client to epoll and ssl map"); // 记录日志信息。
         }
     }
 
     // 处理HTTP请求，包括解析请求、路由处理、通过SSL发送响应。
-    void processRequest(const char* buffer, int fd, SSL* ssl) {
+    void processRequest(const char* buffer, int fd, SSL* ssl, const RequestTiming& timing) {
         HttpRequest request; // 创建HTTP请求对象。
         if (!request.parse(buffer)) { // 尝试解析HTTP请求。
             LOG_ERROR("Failed to parse HTTP request"); // 如果解析失败，记录错误日志。
@@ -192,18 +288,22 @@ private:
 
         HttpResponse response = router.routeRequest(request); // 根据路由处理请求。
         std::string response_str = response.toString(); // 将响应转换为字符串形式。
+        int64_t handlerDoneNs = steadyNs();
 
         int bytes_sent = SSL_write(ssl, response_str.c_str(), response_str.length()); // 通过SSL发送响应。
+        logAccess(fd, request, response.getStatusCode(), bytes_sent, timing, handlerDoneNs, steadyNs());
         if (bytes_sent <= 0) { // 检查发送结果。
             int err = SSL_get_error(ssl, bytes_sent); // 获取SSL错误代码。
             LOG_ERROR("SSL_write failed with SSL error: %d", err); // 记录SSL发送失败的错误日志。
         } else {
-            LOG_INFO("Response sent to client"); // 记录响应发送成功的日志。
+            LOG_DEBUG("Response sent to client"); // 记录响应发送成功的日志。
         }
     }
 
     // 处理每个客户端连接，包括读取请求、处理请求、发送响应。
-    void handleConnection(int fd) {
+    // queuedNs: 连接被提交到线程池的时间，用于访问日志中的排队耗时
+    void handleConnection(int fd, int64_t queuedNs) {
+        RequestTiming timing = {queuedNs, steadyNs(), 0};
         SSL* ssl = getSSLFromMap(fd); // 从映射中获取关联的SSL对象。
         if (!ssl) { // 检查SSL对象是否存在。
             LOG_ERROR("SSL object not found for fd: %d", fd); // 如果不存在，记录错误日志。
@@ -216,11 +316,12 @@ private:
 
         if (bytes_read > 0) { // 检查读取结果。
             buffer[bytes_read] = '\0'; // 确保字符串以空字符结束。
-            processRequest(buffer, fd, ssl); // 处理HTTP请求。
+            timing.readDoneNs = steadyNs();
+            processRequest(buffer, fd, ssl, timing); // 处理HTTP请求。
         } else if (bytes_read <= 0) { // 如果读取失败，
             int err = SSL_get_error(ssl, bytes_read); // 获取SSL错误代码。
             if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) { // 检查是否是非阻塞IO的正常等待状态。
-                LOG_INFO("SSL_read needs more data, waiting for next epoll event."); // 记录日志，等待更多数据。
+                LOG_DEBUG("SSL_read needs more data, waiting for next epoll event."); // 记录日志，等待更多数据。
             } else {
                 LOG_ERROR("SSL_read failed for fd: %d with SSL error: %d", fd, err); // 记录SSL读取失败的错误日志。
                 ERR_print_errors_fp(stderr); // 打印错误信息到标准错误输出。
@@ -238,12 +339,13 @@ private:
 
         // 循环接受所有到达的连接请求
         while ((client_fd = accept(server_fd, (struct sockaddr*)&client_addr, &client_len)) > 0) {
-            LOG_INFO("Accepted new connection, fd: %d", client_fd); // 日志记录新连接的文件描述符
+            LOG_DEBUG("Accepted new connection, fd: %d", client_fd); // 日志记录新连接的文件描述符
             setNonBlocking(client_fd); // 设置新连接为非阻塞模式
+            rememberPeer(client_fd, client_addr); // 记录对端地址，供访问日志使用
 
             SSL* ssl = SSL_new(sslCtx); // 为新连接创建一个新的SSL对象
             SSL_set_fd(ssl, client_fd); // 将新创建的SSL对象与客户端的文件描述符绑定
-            LOG_INFO("SSL object created and set for fd: %d", client_fd); // 记录SSL对象创建和设置的日志
+            LOG_DEBUG("SSL object created and set for fd: %d", client_fd); // 记录SSL对象创建和设置的日志
 
             // 尝试进行非阻塞的SSL握手
             while (true) {
@@ -1,46 +1,822 @@
-#include <mutex>
-#include <fstream>
-#include <string>
+#include <atomic>
 #include <chrono>
-#include <ctime>
+#include <condition_variable>
+#include <cerrno>
 #include <cstdarg>
+#include <cstdio>
+#include <cctype>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 enum LogLevel {
+    DEBUG,
     INFO,
     WARNING,
     ERROR
 };
 
+// 编译期最低级别：低于它的 LOG_* 调用在编译时整个被去掉，参数也不会被求值
+// 例如 g++ -DLOG_COMPILE_LEVEL=INFO ... 去掉所有 LOG_DEBUG
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL DEBUG
+#endif
+
+// 一个模块（源文件，按文件名去掉扩展名，例如 HttpServer）的运行期日志级别
+struct LogModule {
+    std::string name;
+    std::atomic<int> level{-1}; // -1 表示跟随全局级别
+};
+
+// fsync 策略：日志写入内核后何时落盘
+enum class FsyncPolicy {
+    Never,       // 只写入页缓存，由内核决定何时落盘（默认，吞吐最高）
+    EveryFlush,  // 每次批量写入后都 fsync，最安全但最慢
+    Periodic     // 每隔 fsyncInterval fsync 一次
+};
+
+// 日志配置，在第一次写日志之前调用 Logger::init 生效；不调用则使用默认值
+struct LoggerOptions {
+    std::string path;                                       // 日志文件路径；为空时文本写 server.log，二进制写 server.log.bin
+    std::chrono::milliseconds flushInterval{100};           // 后台线程批量写入的间隔
+    FsyncPolicy fsyncPolicy = FsyncPolicy::Never;
+    std::chrono::milliseconds fsyncInterval{1000};          // Periodic 策略下的 fsync 间隔
+    size_t ringCapacity = 1024;                             // 每个线程环形缓冲区可容纳的日志条数（2 的幂）
+    bool deferredFormatting = false;  // 热路径只拷贝格式串指针、TSC 时间戳和原始参数，由后台线程格式化
+    bool binaryOutput = false;        // 后台线程直接写二进制记录，不做格式化，用 logdecode 离线还原为文本
+    LogLevel level = INFO;            // 运行期全局级别，SIGUSR2 恢复为该级别
+};
+
+// 延迟格式化的参数编码：每个参数写一个类型标记和原始值
+//   'i' int64   'u' uint64   'd' double   'p' 指针   's' uint16 长度 + 字符串内容
+// 格式化时按格式串中的转换说明依次取参数，所以只需要知道值本身，不需要保留原来的 C 类型
+class LogArgWriter {
+public:
+    LogArgWriter(char* begin, size_t size) : pos(begin), end(begin + size) {}
+
+    template <typename T>
+    void add(const T& value) {
+        if constexpr (std::is_same<T, bool>::value || std::is_enum<T>::value ||
+                      (std::is_integral<T>::value && std::is_signed<T>::value)) {
+            int64_t v = static_cast<int64_t>(value);
+            put('i', &v, sizeof(v));
+        } else if constexpr (std::is_integral<T>::value) {
+            uint64_t v = static_cast<uint64_t>(value);
+            put('u', &v, sizeof(v));
+        } else if constexpr (std::is_floating_point<T>::value) {
+            double v = static_cast<double>(value);
+            put('d', &v, sizeof(v));
+        } else if constexpr (std::is_convertible<const T&, const char*>::value) {
+            addString(value); // 字符串必须拷贝内容，调用返回后指针可能已经失效
+        } else if constexpr (std::is_pointer<T>::value) {
+            uint64_t v = reinterpret_cast<uintptr_t>(value);
+            put('p', &v, sizeof(v));
+        } else {
+            static_assert(std::is_pointer<T>::value, "unsupported log argument type");
+        }
+    }
+
+    size_t used(char* begin) const { return static_cast<size_t>(pos - begin); }
+
+private:
+    char* pos;
+    char* end;
+    bool full = false; // 放不下之后的参数全部丢弃，格式化时显示为 <?>
+
+    void put(char tag, const void* data, size_t n) {
+        if (full || static_cast<size_t>(end - pos) < n + 1) { full = true; return; }
+        *pos++ = tag;
+        memcpy(pos, data, n);
+        pos += n;
+    }
+
+    void addString(const char* str) {
+        if (!str) str = "(null)";
+        size_t room = static_cast<size_t>(end - pos);
+        if (full || room < 3) { full = true; return; }
+        size_t n = strlen(str);
+        if (n > room - 3) n = room - 3; // 空间不够时截断字符串
+        uint16_t len = static_cast<uint16_t>(n);
+        *pos++ = 's';
+        memcpy(pos, &len, sizeof(len));
+        pos += sizeof(len);
+        memcpy(pos, str, n);
+        pos += n;
+    }
+};
+
+// 异步日志：
+//   1) 每个线程有自己的单生产者单消费者环形缓冲区，写日志只是在本线程格式化到槽位里，不加锁、不做 I/O
+//   2) 后台线程按 flushInterval 收集所有线程的日志，用 writev 批量写入一直打开的 O_APPEND 文件
+//   3) 缓冲区满时直接丢弃并计数，内存有上限，请求路径永远不会被磁盘拖慢
 class Logger {
 public:
+    static constexpr size_t kMaxMessage = 498; // 单条日志正文的最大字节数（含结尾的 0），超出部分被截断
+
+    static void init(const LoggerOptions& options) {
+        instance().configure(options);
+        defaultLevel.store(options.level, std::memory_order_relaxed);
+        globalLevel.store(options.level, std::memory_order_relaxed);
+    }
+
+    // 运行期级别检查，在参数求值和格式化之前执行：两次 relaxed 原子读
+    static bool enabled(LogLevel level, const LogModule* module) {
+        int threshold = module->level.load(std::memory_order_relaxed);
+        if (threshold < 0) threshold = globalLevel.load(std::memory_order_relaxed);
+        return level >= threshold;
+    }
+
+    // 按源文件路径取得模块（每个调用点只在第一次执行时查找一次）
+    static LogModule* module(const char* file) {
+        std::string name = file;
+        size_t slash = name.find_last_of('/');
+        if (slash != std::string::npos) name = name.substr(slash + 1);
+        size_t dot = name.find('.');
+        if (dot != std::string::npos) name = name.substr(0, dot);
+        return instance().findModule(name);
+    }
+
+    static void setLevel(LogLevel level) {
+        globalLevel.store(level, std::memory_order_relaxed);
+    }
+
+    // 设置模块级别，level 为 -1 时恢复为跟随全局级别；模块还没有输出过日志也可以提前设置
+    static void setModuleLevel(const std::string& name, int level) {
+        instance().findModule(name)->level.store(level, std::memory_order_relaxed);
+    }
+
+    // 解析级别名（debug/info/warning/error，不区分大小写），无法识别时返回 -1
+    static int parseLevel(std::string name) {
+        for (char& c : name) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        if (name == "debug") return DEBUG;
+        if (name == "info") return INFO;
+        if (name == "warning" || name == "warn") return WARNING;
+        if (name == "error") return ERROR;
+        return -1;
+    }
+
+    // 按描述设置级别，例如 "info,HttpServer=debug,Database=warning"
+    // 不带模块名的一项是全局级别；模块级别写 inherit 表示恢复跟随全局。返回是否全部解析成功
+    // asDefault 为 true 时（启动配置）全局级别同时作为 SIGUSR2 恢复的级别
+    static bool configureLevels(const std::string& spec, bool asDefault = false) {
+        bool ok = true;
+        size_t start = 0;
+        while (start <= spec.size()) {
+            size_t comma = spec.find(',', start);
+            std::string item = spec.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+            start = comma == std::string::npos ? spec.size() + 1 : comma + 1;
+            if (item.empty()) continue;
+            size_t eq = item.find('=');
+            if (eq == std::string::npos) {
+                int level = parseLevel(item);
+                if (level < 0) { ok = false; continue; }
+                setLevel(static_cast<LogLevel>(level));
+                if (asDefault) defaultLevel.store(level, std::memory_order_relaxed);
+            } else {
+                std::string value = item.substr(eq + 1);
+                int level = value == "inherit" ? -1 : parseLevel(value);
+                if (level < 0 && value != "inherit") { ok = false; continue; }
+                setModuleLevel(item.substr(0, eq), level);
+            }
+        }
+        return ok;
+    }
+
+    // 当前级别的描述，格式与 configureLevels 相同
+    static std::string describeLevels() {
+        Logger& logger = instance();
+        std::string result = levelName(globalLevel.load(std::memory_order_relaxed));
+        std::lock_guard<std::mutex> lock(logger.modulesMutex);
+        for (auto& entry : logger.modules) {
+            int level = entry.second->level.load(std::memory_order_relaxed);
+            if (level >= 0) result += "," + entry.first + "=" + levelName(level);
+        }
+        return result;
+    }
+
+    // SIGUSR1 临时切换到 DEBUG，SIGUSR2 恢复为启动时配置的级别（LoggerOptions::level 或 LOG_LEVEL），信号处理函数中只有原子写
+    static void installSignalHandlers() {
+        signal(SIGUSR1, [](int) { globalLevel.store(DEBUG, std::memory_order_relaxed); });
+        signal(SIGUSR2, [](int) {
+            globalLevel.store(defaultLevel.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        });
+    }
+
+    // LOG_* 宏的入口。format 必须是字符串字面量：延迟格式化模式下只保存它的地址
+    template <typename... Args>
+    static void log(LogLevel level, const char* format, const Args&... args) {
+        Ring* ring = localRing();
+        Record* record = ring->beginWrite();
+        if (!record) {
+            // 缓冲区已满：丢弃本条日志，由后台线程输出丢弃计数
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        record->ticks = readTicks();
+        record->level = static_cast<uint8_t>(level);
+
+        if (instance().deferred.load(std::memory_order_relaxed)) {
+            // 只拷贝格式串地址和原始参数，几十纳秒
+            record->deferred = 1;
+            memcpy(record->text, &format, sizeof(format));
+            LogArgWriter writer(record->text + sizeof(format), sizeof(record->text) - sizeof(format));
+            (writer.add(args), ...);
+            record->length = static_cast<uint32_t>(sizeof(format) + writer.used(record->text + sizeof(format)));
+        } else {
+            record->deferred = 0;
+            int n;
+            if constexpr (sizeof...(Args) == 0) {
+                n = snprintf(record->text, sizeof(record->text), "%s", format);
+            } else {
+                n = snprintf(record->text, sizeof(record->text), format, args...);
+            }
+            record->length = clampLength(n);
+        }
+        commit(ring, level);
+    }
+
+    // 兼容旧接口：立即格式化（printf 风格的可变参数）
     static void logMessage(LogLevel level, const char* format, ...) {
-        static std::mutex logMutex; // 静态互斥锁，保证全局唯一
-        std::lock_guard<std::mutex> guard(logMutex); // 使用 lock_guard 自动管理互斥锁
-
-        std::ofstream logFile("server.log", std::ios::app);
-        
-        auto now = std::chrono::system_clock::now();
-        auto now_c = std::chrono::system_clock::to_time_t(now);
-        
-        std::string levelStr;
-        switch (level) {
-            case INFO: levelStr = "INFO"; break;
-            case WARNING: levelStr = "WARNING"; break;
-            case ERROR: levelStr = "ERROR"; break;
+        Ring* ring = localRing();
+        Record* record = ring->beginWrite();
+        if (!record) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
         }
+        record->ticks = readTicks();
+        record->level = static_cast<uint8_t>(level);
+        record->deferred = 0;
 
         va_list args;
         va_start(args, format);
-        char buffer[2048];
-        vsnprintf(buffer, sizeof(buffer), format, args);
+        int n = vsnprintf(record->text, sizeof(record->text), format, args);
         va_end(args);
+        record->length = clampLength(n);
+        commit(ring, level);
+    }
+
+    // 按格式串把编码后的参数还原为文本，返回写入 out 的长度（后台线程和 logdecode 共用）
+    // 只支持 printf 的常见转换：d i u o x X c s p f F e E g G a A 和 %%，不支持 * 宽度
+    static size_t formatDeferred(const char* format, const char* args, size_t argsLen, char* out, size_t outSize) {
+        if (outSize == 0) return 0;
+        const char* argEnd = args + argsLen;
+        size_t n = 0;
+        auto append = [&](const char* data, size_t len) {
+            if (n + len >= outSize) len = outSize - 1 - n;
+            memcpy(out + n, data, len);
+            n += len;
+        };
+        for (const char* p = format; *p && n + 1 < outSize; ++p) {
+            if (*p != '%') { append(p, 1); continue; }
+            if (p[1] == '%') { append("%", 1); ++p; continue; }
+
+            // 取出一个转换说明：标志、宽度、精度，丢弃长度修饰符（参数已统一为 64 位）
+            char spec[32] = "%";
+            size_t specLen = 1;
+            const char* q = p + 1;
+            while (*q && strchr("-+ #0123456789.", *q) && specLen < sizeof(spec) - 4) spec[specLen++] = *q++;
+            while (*q && strchr("hljztLq", *q)) ++q;
+            char conv = *q;
+            if (!conv) break;
+            p = q;
+
+            char tag = args < argEnd ? *args : 0;
+            char tmp[256];
+            int len = -1;
+            if (strchr("diouxXc", conv) && (tag == 'i' || tag == 'u' || tag == 'p')) {
+                uint64_t raw;
+                memcpy(&raw, args + 1, sizeof(raw));
+                args += 1 + sizeof(raw);
+                if (conv == 'c') {
+                    spec[specLen++] = 'c'; spec[specLen] = 0;
+                    len = snprintf(tmp, sizeof(tmp), spec, static_cast<int>(raw));
+                } else {
+                    spec[specLen++] = 'l'; spec[specLen++] = 'l'; spec[specLen++] = conv; spec[specLen] = 0;
+                    len = snprintf(tmp, sizeof(tmp), spec, static_cast<long long>(raw));
+                }
+            } else if (strchr("fFeEgGaA", conv) && tag == 'd') {
+                double v;
+                memcpy(&v, args + 1, sizeof(v));
+                args += 1 + sizeof(v);
+                spec[specLen++] = conv; spec[specLen] = 0;
+                len = snprintf(tmp, sizeof(tmp), spec, v);
+            } else if (conv == 'p' && (tag == 'p' || tag == 'u' || tag == 'i')) {
+                uint64_t raw;
+                memcpy(&raw, args + 1, sizeof(raw));
+                args += 1 + sizeof(raw);
+                len = snprintf(tmp, sizeof(tmp), "%p", reinterpret_cast<void*>(static_cast<uintptr_t>(raw)));
+            } else if (conv == 's' && tag == 's') {
+                uint16_t strLen;
+                memcpy(&strLen, args + 1, sizeof(strLen));
+                const char* str = args + 1 + sizeof(strLen);
+                args = str + strLen;
+                if (specLen == 1) {
+                    append(str, strLen); // 最常见的 %s 直接拷贝
+                    continue;
+                }
+                spec[specLen++] = '.'; spec[specLen++] = '*'; spec[specLen++] = 's'; spec[specLen] = 0;
+                // 精度由字符串实际长度限定（字符串没有结尾的 0）
+                len = snprintf(tmp, sizeof(tmp), spec, static_cast<int>(strLen), str);
+            }
+            if (len < 0) {
+                // 参数缺失或类型不匹配：跳过该参数，后面的参数仍能对上
+                if (tag == 'i' || tag == 'u' || tag == 'p' || tag == 'd') {
+                    args += 1 + sizeof(uint64_t);
+                } else if (tag == 's') {
+                    uint16_t strLen;
+                    memcpy(&strLen, args + 1, sizeof(strLen));
+                    args += 1 + sizeof(strLen) + strLen;
+                }
+                append("<?>", 3);
+                continue;
+            }
+            append(tmp, static_cast<size_t>(len) < sizeof(tmp) ? static_cast<size_t>(len) : sizeof(tmp) - 1);
+        }
+        out[n] = 0;
+        return n;
+    }
+
+    // 格式化行首 "2024-03-02 08:55:34.123456 [INFO] "，同一秒内只格式化一次日期
+    static int formatPrefix(int64_t wallNs, int level, char* out, size_t size) {
+        thread_local time_t cachedSecond = -1;
+        thread_local char cachedDate[32];
+        time_t seconds = static_cast<time_t>(wallNs / 1000000000);
+        long micros = static_cast<long>(wallNs % 1000000000 / 1000);
+        if (seconds != cachedSecond) {
+            struct tm tm;
+            localtime_r(&seconds, &tm);
+            strftime(cachedDate, sizeof(cachedDate), "%Y-%m-%d %H:%M:%S", &tm);
+            cachedSecond = seconds;
+        }
+        return snprintf(out, size, "%s.%06ld [%s] ", cachedDate, micros, levelName(level));
+    }
+
+    static const char* levelName(int level) {
+        switch (level) {
+            case DEBUG: return "DEBUG";
+            case INFO: return "INFO";
+            case WARNING: return "WARNING";
+            case ERROR: return "ERROR";
+        }
+        return "UNKNOWN";
+    }
 
-        logFile << std::ctime(&now_c) << " [" << levelStr << "] " << buffer << std::endl;
-        
-        logFile.close();
+    // 二进制日志文件格式（小端）：
+    //   文件头 "SRVLOG01"
+    //   'F' u32 id, u32 len, 格式串        每个格式串在本次运行中第一次出现时写一次
+    //   'R' u32 id, i64 时间(ns), u8 级别, u16 len, 编码后的参数
+    //   'T' i64 时间(ns), u8 级别, u16 len, 已格式化的文本
+    static constexpr char kBinaryMagic[9] = "SRVLOG01";
+
+    // 启动以来因缓冲区已满被丢弃的日志条数
+    static uint64_t droppedCount() {
+        return instance().totalDropped.load(std::memory_order_relaxed);
+    }
+
+    // 立即把所有线程缓冲区中的日志写入文件（阻塞直到写完）
+    static void flush() {
+        instance().flushNow();
+    }
+
+    ~Logger() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopping = true;
+        }
+        wakeCond.notify_one();
+        if (flusher.joinable()) flusher.join();
+        drainAll(); // 退出前写出剩余日志
+        if (fd >= 0) {
+            fsync(fd);
+            close(fd);
+        }
+    }
+
+private:
+    // 一条日志记录，正好 512 字节
+    // 延迟格式化时 text 中是格式串地址加编码后的参数，否则是格式化好的文本
+    struct Record {
+        uint64_t ticks;     // TSC 计数（非 x86 为 steady_clock 纳秒），由后台线程换算为墙上时间
+        uint32_t length;
+        uint8_t level;
+        uint8_t deferred;
+        char text[kMaxMessage];
+    };
+
+    // 单生产者（所属线程）单消费者（后台线程）环形缓冲区
+    struct Ring {
+        explicit Ring(size_t capacity) : records(capacity), mask(capacity - 1) {}
+
+        std::vector<Record> records;
+        size_t mask;
+        alignas(64) std::atomic<size_t> head{0};    // 生产者写入位置
+        alignas(64) std::atomic<size_t> tail{0};    // 消费者读取位置
+        std::atomic<uint64_t> dropped{0};           // 缓冲区满时丢弃的条数
+        std::atomic<bool> closed{false};            // 所属线程已退出，读空后即可回收
+
+        Record* beginWrite() {
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h - tail.load(std::memory_order_acquire) >= records.size()) return nullptr;
+            return &records[h & mask];
+        }
+        // 提交刚写入的记录，返回提交后缓冲区中的条数
+        size_t commitWrite() {
+            size_t h = head.load(std::memory_order_relaxed) + 1;
+            head.store(h, std::memory_order_release);
+            return h - tail.load(std::memory_order_relaxed);
+        }
+    };
+
+    // 线程退出时把自己的缓冲区标记为已关闭，剩余日志仍会被后台线程写出
+    struct RingHandle {
+        std::shared_ptr<Ring> ring;
+        ~RingHandle() {
+            if (ring) ring->closed.store(true, std::memory_order_release);
+        }
+    };
+
+    LoggerOptions options;
+    int fd = -1;
+    std::mutex ringsMutex;                      // 只在注册新线程和后台线程遍历时使用
+    std::vector<std::shared_ptr<Ring>> rings;
+    std::mutex flushMutex;                      // 保证同一时刻只有一个线程在写文件
+    std::mutex wakeMutex;
+    std::condition_variable wakeCond;
+    bool stopping = false;
+    bool wakeRequested = false;
+    std::thread flusher;
+    std::atomic<uint64_t> totalDropped{0};
+    std::atomic<bool> deferred{false};
+    static inline std::atomic<int> globalLevel{INFO};   // 运行期全局级别
+    static inline std::atomic<int> defaultLevel{INFO};  // 配置的级别，SIGUSR2 恢复到这里
+    std::mutex modulesMutex;
+    std::unordered_map<std::string, std::unique_ptr<LogModule>> modules; // 模块只增不减，指针一直有效
+    // 时钟换算：墙上时间 = wallBase + (ticks - ticksBase) * nsPerTick，后台线程运行中不断校准
+    uint64_t ticksBase = 0;
+    int64_t wallBase = 0;
+    double nsPerTick = 1.0;
+    std::unordered_map<const char*, uint32_t> formatIds; // 二进制输出：格式串地址 -> 字典编号
+    std::string binaryBatch;                              // 二进制输出的批量缓冲
+    std::vector<char> scratch;                            // 文本输出时延迟格式化的临时缓冲
+    uint64_t reportedDropped = 0;
+    uint64_t retiredDropped = 0;  // 已回收缓冲区的丢弃计数
+    std::chrono::steady_clock::time_point lastFsync = std::chrono::steady_clock::now();
+    static constexpr size_t kBatch = 128;        // 每次 writev 最多 128 条（384 个 iovec，低于 IOV_MAX）
+    static constexpr size_t kScratchLine = 1024; // 延迟格式化的单行上限
+
+    Logger() : scratch(kBatch * kScratchLine) {
+        calibrateClock();
+        openFile();
+        flusher = std::thread([this]() { flushLoop(); });
+    }
+
+    static Logger& instance() {
+        static Logger logger;
+        return logger;
+    }
+
+    LogModule* findModule(const std::string& name) {
+        std::lock_guard<std::mutex> lock(modulesMutex);
+        auto& entry = modules[name];
+        if (!entry) {
+            entry = std::make_unique<LogModule>();
+            entry->name = name;
+        }
+        return entry.get();
+    }
+
+    void configure(const LoggerOptions& newOptions) {
+        std::lock_guard<std::mutex> lock(flushMutex);
+        std::lock_guard<std::mutex> wakeLock(wakeMutex); // 后台线程在 wakeMutex 下读取 flushInterval
+        size_t capacity = 1;
+        while (capacity < newOptions.ringCapacity) capacity <<= 1;
+        options = newOptions;
+        options.ringCapacity = capacity;
+        deferred.store(options.deferredFormatting, std::memory_order_relaxed);
+        if (fd >= 0) close(fd);
+        openFile();
+    }
+
+    // 当前模式下的文件路径：没有指定时文本和二进制各写各的文件
+    std::string filePath() const {
+        if (!options.path.empty()) return options.path;
+        return options.binaryOutput ? "server.log.bin" : "server.log";
+    }
+
+    void openFile() {
+        std::string path = filePath();
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd >= 0 && !matchesMode()) {
+            // 已有内容与当前模式不符（在文本日志后面追加二进制记录，logdecode 无法解析；反之文本混进二进制文件）：
+            // 旧文件改名为 <path>.<时间戳> 保留下来，重新创建
+            std::string rotated = path + "." + std::to_string(static_cast<long long>(time(nullptr)));
+            for (int i = 1; ::access(rotated.c_str(), F_OK) == 0; ++i) {
+                rotated = path + "." + std::to_string(static_cast<long long>(time(nullptr))) + "-" + std::to_string(i);
+            }
+            close(fd);
+            if (::rename(path.c_str(), rotated.c_str()) == 0) {
+                fprintf(stderr, "logger: %s does not match the %s format, moved to %s\n", path.c_str(),
+                        options.binaryOutput ? "binary" : "text", rotated.c_str());
+            }
+            fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        }
+        formatIds.clear(); // 新文件需要重新写格式串字典
+        if (fd >= 0 && options.binaryOutput && lseek(fd, 0, SEEK_END) == 0) {
+            struct iovec iov = {const_cast<char*>(kBinaryMagic), 8};
+            writeAll(&iov, 1);
+        }
+    }
+
+    // 文件为空，或文件头与当前模式一致（二进制文件以 kBinaryMagic 开头，文本文件不以它开头）
+    bool matchesMode() const {
+        char header[8];
+        ssize_t n = pread(fd, header, sizeof(header), 0);
+        if (n <= 0) return true;
+        bool binary = n == 8 && memcmp(header, kBinaryMagic, 8) == 0;
+        return binary == options.binaryOutput;
+    }
+
+    static uint64_t readTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    static int64_t wallNowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // 启动时用 2ms 粗略测出 TSC 频率，之后每次批量写入时用更长的时间跨度重新校准
+    void calibrateClock() {
+        ticksBase = readTicks();
+        wallBase = wallNowNs();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        recalibrateClock();
+    }
+
+    void recalibrateClock() {
+        uint64_t ticks = readTicks();
+        int64_t wall = wallNowNs();
+        if (ticks > ticksBase && wall > wallBase) {
+            nsPerTick = static_cast<double>(wall - wallBase) / static_cast<double>(ticks - ticksBase);
+        }
+    }
+
+    int64_t toWallNs(uint64_t ticks) const {
+        return wallBase + static_cast<int64_t>(static_cast<double>(static_cast<int64_t>(ticks - ticksBase)) * nsPerTick);
+    }
+
+    static uint32_t clampLength(int n) {
+        if (n < 0) return 0;
+        return n < static_cast<int>(kMaxMessage) ? static_cast<uint32_t>(n) : static_cast<uint32_t>(kMaxMessage - 1);
+    }
+
+    static void commit(Ring* ring, LogLevel level) {
+        size_t used = ring->commitWrite();
+        // 错误日志尽快写出；缓冲区写到一半时也提前唤醒后台线程，减少突发日志被丢弃
+        if (level == ERROR || used == ring->records.size() / 2) {
+            instance().wakeFlusher();
+        }
+    }
+
+    static Ring* localRing() {
+        thread_local RingHandle handle;
+        if (!handle.ring) {
+            Logger& logger = instance();
+            handle.ring = std::make_shared<Ring>(logger.options.ringCapacity);
+            std::lock_guard<std::mutex> lock(logger.ringsMutex);
+            logger.rings.push_back(handle.ring);
+        }
+        return handle.ring.get();
+    }
+
+    void wakeFlusher() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            wakeRequested = true;
+        }
+        wakeCond.notify_one();
+    }
+
+    void flushLoop() {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        while (!stopping) {
+            wakeCond.wait_for(lock, options.flushInterval, [this]() { return stopping || wakeRequested; });
+            wakeRequested = false;
+            lock.unlock();
+            drainAll();
+            lock.lock();
+        }
+    }
+
+    void flushNow() {
+        drainAll();
+        std::lock_guard<std::mutex> lock(flushMutex);
+        if (fd >= 0) fsync(fd);
+    }
+
+    // 收集所有线程缓冲区中的日志，批量写入文件
+    void drainAll() {
+        std::lock_guard<std::mutex> flushLock(flushMutex);
+        recalibrateClock();
+        std::vector<std::shared_ptr<Ring>> snapshot;
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            snapshot = rings;
+        }
+
+        uint64_t dropped = 0;
+        for (auto& ring : snapshot) {
+            drainRing(*ring);
+            dropped += ring->dropped.load(std::memory_order_relaxed);
+        }
+        reportDrops(dropped);
+        syncIfNeeded();
+
+        // 回收已退出线程的空缓冲区
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (size_t i = 0; i < rings.size();) {
+            Ring& ring = *rings[i];
+            if (ring.closed.load(std::memory_order_acquire) &&
+                ring.tail.load(std::memory_order_relaxed) == ring.head.load(std::memory_order_acquire)) {
+                retiredDropped += ring.dropped.load(std::memory_order_relaxed);
+                rings[i] = rings.back();
+                rings.pop_back();
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    // 把一个缓冲区中的日志写出：每条日志对应 3 个 iovec（时间与级别前缀、正文、换行）
+    // 已格式化的正文直接引用槽位，不再拷贝；延迟格式化的记录在这里才格式化
+    void drainRing(Ring& ring) {
+        static char newline = '\n';
+        struct iovec iov[kBatch * 3];
+        char prefixes[kBatch][64];
+
+        size_t tail = ring.tail.load(std::memory_order_relaxed);
+        size_t head = ring.head.load(std::memory_order_acquire);
+        while (tail != head) {
+            size_t count = 0;
+            if (options.binaryOutput) {
+                binaryBatch.clear();
+                for (size_t i = tail; i != head && count < kBatch; ++i, ++count) {
+                    appendBinary(ring.records[i & ring.mask]);
+                }
+                struct iovec one = {&binaryBatch[0], binaryBatch.size()};
+                writeAll(&one, 1);
+            } else {
+                for (size_t i = tail; i != head && count < kBatch; ++i, ++count) {
+                    Record& record = ring.records[i & ring.mask];
+                    int len = formatPrefix(toWallNs(record.ticks), record.level, prefixes[count], sizeof(prefixes[count]));
+                    iov[count * 3] = {prefixes[count], static_cast<size_t>(len)};
+                    if (record.deferred) {
+                        char* line = &scratch[count * kScratchLine];
+                        const char* format;
+                        memcpy(&format, record.text, sizeof(format));
+                        size_t n = formatDeferred(format, record.text + sizeof(format), record.length - sizeof(format),
+                                                  line, kScratchLine);
+                        iov[count * 3 + 1] = {line, n};
+                    } else {
+                        iov[count * 3 + 1] = {record.text, record.length};
+                    }
+                    iov[count * 3 + 2] = {&newline, 1};
+                }
+                writeAll(iov, static_cast<int>(count * 3));
+            }
+            tail += count;
+            ring.tail.store(tail, std::memory_order_release); // 写完之后才释放槽位
+        }
+    }
+
+    // 按二进制格式追加一条记录，格式串第一次出现时先写字典项
+    void appendBinary(const Record& record) {
+        int64_t wallNs = toWallNs(record.ticks);
+        uint8_t level = record.level;
+        if (record.deferred) {
+            const char* format;
+            memcpy(&format, record.text, sizeof(format));
+            auto it = formatIds.find(format);
+            if (it == formatIds.end()) {
+                uint32_t id = static_cast<uint32_t>(formatIds.size());
+                it = formatIds.emplace(format, id).first;
+                uint32_t len = static_cast<uint32_t>(strlen(format));
+                binaryBatch.push_back('F');
+                binaryBatch.append(reinterpret_cast<const char*>(&id), sizeof(id));
+                binaryBatch.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                binaryBatch.append(format, len);
+            }
+            uint16_t len = static_cast<uint16_t>(record.length - sizeof(format));
+            binaryBatch.push_back('R');
+            binaryBatch.append(reinterpret_cast<const char*>(&it->second), sizeof(uint32_t));
+            binaryBatch.append(reinterpret_cast<const char*>(&wallNs), sizeof(wallNs));
+            binaryBatch.append(reinterpret_cast<const char*>(&level), sizeof(level));
+            binaryBatch.append(reinterpret_cast<const char*>(&len), sizeof(len));
+            binaryBatch.append(record.text + sizeof(format), len);
+        } else {
+            appendBinaryText(wallNs, level, record.text, record.length);
+        }
+    }
+
+    void appendBinaryText(int64_t wallNs, uint8_t level, const char* text, size_t length) {
+        uint16_t len = static_cast<uint16_t>(length);
+        binaryBatch.push_back('T');
+        binaryBatch.append(reinterpret_cast<const char*>(&wallNs), sizeof(wallNs));
+        binaryBatch.append(reinterpret_cast<const char*>(&level), sizeof(level));
+        binaryBatch.append(reinterpret_cast<const char*>(&len), sizeof(len));
+        binaryBatch.append(text, len);
+    }
+
+    // writev 可能只写入一部分，循环直到全部写完
+    void writeAll(struct iovec* iov, int count) {
+        if (fd < 0) return;
+        while (count > 0) {
+            ssize_t n = writev(fd, iov, count);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return; // 磁盘满等错误：放弃本批，不阻塞后续日志
+            }
+            while (count > 0 && static_cast<size_t>(n) >= iov->iov_len) {
+                n -= iov->iov_len;
+                ++iov;
+                --count;
+            }
+            if (count > 0) {
+                iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+                iov->iov_len -= n;
+            }
+        }
+    }
+
+    // 有新的丢弃时写一条警告，方便发现日志量超出缓冲区
+    void reportDrops(uint64_t liveDropped) {
+        uint64_t dropped = liveDropped + retiredDropped;
+        totalDropped.store(dropped, std::memory_order_relaxed);
+        if (dropped == reportedDropped) return;
+        char line[96];
+        int len = snprintf(line, sizeof(line), "logger dropped %llu records (total %llu)",
+                           static_cast<unsigned long long>(dropped - reportedDropped),
+                           static_cast<unsigned long long>(dropped));
+        int64_t wallNs = wallNowNs();
+        if (options.binaryOutput) {
+            binaryBatch.clear();
+            appendBinaryText(wallNs, WARNING, line, static_cast<size_t>(len));
+            struct iovec iov = {&binaryBatch[0], binaryBatch.size()};
+            writeAll(&iov, 1);
+        } else {
+            char prefix[64];
+            int prefixLen = formatPrefix(wallNs, WARNING, prefix, sizeof(prefix));
+            line[len++] = '\n';
+            struct iovec iov[2] = {{prefix, static_cast<size_t>(prefixLen)}, {line, static_cast<size_t>(len)}};
+            writeAll(iov, 2);
+        }
+        reportedDropped = dropped;
+    }
+
+    void syncIfNeeded() {
+        if (fd < 0) return;
+        if (options.fsyncPolicy == FsyncPolicy::EveryFlush) {
+            fdatasync(fd);
+        } else if (options.fsyncPolicy == FsyncPolicy::Periodic) {
+            auto now = std::chrono::steady_clock::now();
+            if (now - lastFsync >= options.fsyncInterval) {
+                fdatasync(fd);
+                lastFsync = now;
+            }
+        }
     }
 };
 
-#define LOG_INFO(...) Logger::logMessage(INFO, __VA_ARGS__)
-#define LOG_WARNING(...) Logger::logMessage(WARNING, __VA_ARGS__)
-#define LOG_ERROR(...) Logger::logMessage(ERROR, __VA_ARGS__)
+// 先做编译期判断，再做运行期判断，两者都通过才会求值参数并写日志
+#define LOG_AT(level, ...)                                                     \
+    do {                                                                       \
+        if ((level) >= LOG_COMPILE_LEVEL) {                                    \
+            static LogModule* const logModule_ = Logger::module(__FILE__);     \
+            if (Logger::enabled((level), logModule_)) {                        \
+                Logger::log((level), __VA_ARGS__);                             \
+            }                                                                  \
+        }                                                                      \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(INFO, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT(WARNING, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(ERROR, __VA_ARGS__)
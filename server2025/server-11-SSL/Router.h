@@ -44,7 +44,7 @@ public:
             
             std::string username = params["username"];
             std::string password = params["password"];
-            LOG_INFO("Form body parsed with username: %s, password: %s", username.c_str(), password.c_str());
+            LOG_DEBUG("Form body parsed with username: %s, password: %s", username.c_str(), password.c_str());
             // 调用数据库方法进行用户登录
             if (db.loginUser(username, password)) {
                 return HttpResponse::makeOkResponse("Login Success!");
@@ -0,0 +1,72 @@
+// 二进制日志解码工具：把 binaryOutput 模式写出的日志还原为文本
+// 编译：g++ logdecode.cpp -o logdecode
+// 使用：./logdecode <LoggerOptions::path，二进制模式默认 server.log.bin> > server.log.txt
+#include "Logger.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <binary log file>\n", argv[0]);
+        return 1;
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file.is_open()) {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.compare(0, 8, Logger::kBinaryMagic) != 0) {
+        fprintf(stderr, "%s is not a binary log file\n", argv[1]);
+        return 1;
+    }
+
+    std::unordered_map<uint32_t, std::string> formats; // 格式串字典，每次运行重新编号，后出现的覆盖先出现的
+    const char* p = data.data() + 8;
+    const char* end = data.data() + data.size();
+    char prefix[64];
+    char line[4096];
+
+    // 按类型读取定长字段，数据不完整时停止
+    auto read = [&](void* out, size_t n) {
+        if (static_cast<size_t>(end - p) < n) return false;
+        memcpy(out, p, n);
+        p += n;
+        return true;
+    };
+
+    while (p < end) {
+        char tag = *p++;
+        if (tag == 'F') {
+            uint32_t id, len;
+            if (!read(&id, sizeof(id)) || !read(&len, sizeof(len)) || static_cast<size_t>(end - p) < len) break;
+            formats[id] = std::string(p, len);
+            p += len;
+        } else if (tag == 'R' || tag == 'T') {
+            uint32_t id = 0;
+            int64_t wallNs;
+            uint8_t level;
+            uint16_t len;
+            if (tag == 'R' && !read(&id, sizeof(id))) break;
+            if (!read(&wallNs, sizeof(wallNs)) || !read(&level, sizeof(level)) || !read(&len, sizeof(len)) ||
+                static_cast<size_t>(end - p) < len) break;
+
+            Logger::formatPrefix(wallNs, level, prefix, sizeof(prefix));
+            if (tag == 'T') {
+                std::cout << prefix << std::string(p, len) << '\n';
+            } else {
+                auto it = formats.find(id);
+                const char* format = it != formats.end() ? it->second.c_str() : "<unknown format>";
+                Logger::formatDeferred(format, p, len, line, sizeof(line));
+                std::cout << prefix << line << '\n';
+            }
+            p += len;
+        } else {
+            fprintf(stderr, "corrupt record at offset %zu\n", static_cast<size_t>(p - 1 - data.data()));
+            return 1;
+        }
+    }
+    return 0;
+}
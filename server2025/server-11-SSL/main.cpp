@@ -3,8 +3,24 @@
 #include "Database.h"
 
 int main() {
+    // 日志级别：环境变量 LOG_LEVEL，例如 LOG_LEVEL=info,HttpServer=debug
+    // 运行中 kill -USR1 切换到 DEBUG，kill -USR2 恢复为这里配置的全局级别
+    if (const char* spec = getenv("LOG_LEVEL")) {
+        Logger::configureLevels(spec, true);
+    }
+    Logger::installSignalHandlers();
+
+    // 访问日志：ACCESS_LOG_FORMAT=json 输出 JSON Lines，ACCESS_LOG_SAMPLE=N 每 N 个请求记录 1 个
+    AccessLogOptions accessLog;
+    if (const char* format = getenv("ACCESS_LOG_FORMAT")) {
+        if (std::string(format) == "json") accessLog.format = AccessLogFormat::JsonLines;
+    }
+    if (const char* sample = getenv("ACCESS_LOG_SAMPLE")) {
+        accessLog.sampleEvery = static_cast<uint32_t>(std::max(1, atoi(sample)));
+    }
+
     Database db("users.db"); // 初始化数据库
-    HttpServer server(8080, 10, db);
+    HttpServer server(8080, 10, db, accessLog);
     server.setupRoutes();
     server.start();
     return 0;
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdlib>                   // 引入 std::getenv / std::strtol，用于读取线程数配置
+#include <thread>                    // 引入线程库，用于获取 CPU 核数
+#include <utility>                   // 引入 std::forward，用于完美转发任务
+#include "ThreadPool.h"              // 引入线程池，CPU 执行器和阻塞执行器各用一个
+
+// 执行器类型：注册路由时指定，决定处理函数在哪里执行
+enum class ExecutorKind {
+    Inline,    // 直接在 epoll 线程上执行，只适用于不会阻塞、耗时极短的处理函数
+    Cpu,       // CPU 密集型线程池，线程数等于 CPU 核数，避免过多线程争抢 CPU
+    Blocking   // 阻塞 I/O 线程池（数据库、文件、sleep 等），线程数较多，阻塞时不影响 CPU 任务
+};
+
+// 命名执行器集合：把 CPU 密集任务和阻塞任务隔离到不同的线程池
+// 一批慢速的数据库/I/O 请求只会占满阻塞线程池，不会饿死 CPU 请求，反之亦然
+class Executors {
+public:
+    // cpuThreads: CPU 线程池大小；blockingThreads: 阻塞线程池大小
+    Executors(size_t cpuThreads, size_t blockingThreads)
+        : cpuPool(cpuThreads), blockingPool(blockingThreads) {}
+
+    // 按执行器类型执行任务
+    template<class F>
+    void execute(ExecutorKind kind, F&& task) {
+        switch (kind) {
+            case ExecutorKind::Inline:
+                task();  // 就地执行
+                break;
+            case ExecutorKind::Cpu:
+                cpuPool.enqueue(std::forward<F>(task));
+                break;
+            case ExecutorKind::Blocking:
+                blockingPool.enqueue(std::forward<F>(task));
+                break;
+        }
+    }
+
+    // CPU 线程池的默认大小：CPU 核数（获取失败时取 4）
+    static size_t defaultCpuThreads() {
+        unsigned int n = std::thread::hardware_concurrency();
+        return n > 0 ? n : 4;
+    }
+
+    // 阻塞线程池的默认大小：环境变量 BLOCKING_THREADS（正整数），未设置或无效时取 64
+    // 阻塞任务大部分时间在等待，线程数取决于要同时等待多少个数据库/I/O 操作，而不是 CPU 核数
+    static size_t defaultBlockingThreads() {
+        const char* env = std::getenv("BLOCKING_THREADS");
+        if (env != nullptr) {
+            long n = std::strtol(env, nullptr, 10);
+            if (n > 0) {
+                return static_cast<size_t>(n);
+            }
+        }
+        return 64;
+    }
+
+    // 执行器名称，用于日志
+    static const char* name(ExecutorKind kind) {
+        switch (kind) {
+            case ExecutorKind::Inline: return "inline";
+            case ExecutorKind::Cpu: return "cpu";
+            case ExecutorKind::Blocking: return "blocking";
+        }
+        return "unknown";
+    }
+
+private:
+    ThreadPool cpuPool;       // CPU 密集型任务线程池
+    ThreadPool blockingPool;  // 阻塞 I/O 任务线程池
+};
@@ -0,0 +1,36 @@
+#!/bin/bash
+# 混合压测：同时压 /test_io（阻塞 I/O）和 /test_cpu（CPU 密集），分别输出两类请求的延迟
+# 用法：./bench_mixed.sh [端口] [每类请求数] [每类并发数]
+# 依赖 ab（apt-get install apache2-utils）
+
+PORT=${1:-8080}
+REQUESTS=${2:-200}
+CONCURRENCY=${3:-50}
+OUT_DIR=$(mktemp -d)
+
+echo "Mixed benchmark on port $PORT: $REQUESTS requests x $CONCURRENCY concurrency per class"
+
+# 两类请求同时开始，互相干扰，才能看出执行器隔离的效果
+ab -q -n "$REQUESTS" -c "$CONCURRENCY" "http://localhost:$PORT/test_io" > "$OUT_DIR/io.txt" 2>&1 &
+IO_PID=$!
+ab -q -n "$REQUESTS" -c "$CONCURRENCY" "http://localhost:$PORT/test_cpu" > "$OUT_DIR/cpu.txt" 2>&1 &
+CPU_PID=$!
+wait $IO_PID $CPU_PID
+
+# 从 ab 输出中提取吞吐量和延迟分位数（毫秒）
+report() {
+    local name=$1
+    local file=$2
+    local rps p50 p90 p99 max
+    rps=$(awk '/Requests per second/ {print $4}' "$file")
+    p50=$(awk '$1 == "50%" {print $2}' "$file")
+    p90=$(awk '$1 == "90%" {print $2}' "$file")
+    p99=$(awk '$1 == "99%" {print $2}' "$file")
+    max=$(awk '$1 == "100%" {print $2}' "$file")
+    printf "%-10s rps=%-10s p50=%-6s p90=%-6s p99=%-6s max=%-6s (ms)\n" "$name" "$rps" "$p50" "$p90" "$p99" "$max"
+}
+
+report "test_io" "$OUT_DIR/io.txt"
+report "test_cpu" "$OUT_DIR/cpu.txt"
+
+rm -rf "$OUT_DIR"
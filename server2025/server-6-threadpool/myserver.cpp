@@ -14,17 +14,30 @@
 #include <sstream>
 #include "Logger.h"
 #include "Database.h"
-#include "ThreadPool.h"
+#include "Executors.h"
 
 #define PORT 8080
 #define MAX_EVENTS 10
 
 using RequestHandler = std::function<std::string(const std::string&)>;
 
-std::map<std::string, RequestHandler> get_routes;
-std::map<std::string, RequestHandler> post_routes;
+// 路由项：处理函数 + 执行器提示
+struct Route {
+    RequestHandler handler;
+    ExecutorKind executor;
+};
+
+std::map<std::string, Route> get_routes;
+std::map<std::string, Route> post_routes;
 Database db("users.db");
 
+// 注册路由，executor 指定处理函数在哪个执行器上运行（默认 CPU 线程池）
+void addRoute(const std::string& method, const std::string& path, RequestHandler handler,
+              ExecutorKind executor = ExecutorKind::Cpu) {
+    auto& routes = (method == "POST") ? post_routes : get_routes;
+    routes[path] = Route{std::move(handler), executor};
+}
+
 
 // 然后在 parseFormBody 函数中使用它
 std::map<std::string, std::string> parseFormBody(const std::string& body) {
@@ -54,21 +67,21 @@ std::map<std::string, std::string> parseFormBody(const std::string& body) {
 // 初始化路由表
 void setupRoutes() {
     LOG_INFO("Setting up routes");  // 记录路由设置
-    // GET请求处理
-    get_routes["/"] = [](const std::string& request) {
+    // GET请求处理：返回常量字符串，直接在 epoll 线程执行
+    addRoute("GET", "/", [](const std::string& request) {
         return "Hello, World!";
-    };
-    get_routes["/register"] = [](const std::string& request) {
+    }, ExecutorKind::Inline);
+    addRoute("GET", "/register", [](const std::string& request) {
         // TODO: 实现用户注册逻辑
         return "Please use POST to register";
-    };
-    get_routes["/login"] = [](const std::string& request) {
+    }, ExecutorKind::Inline);
+    addRoute("GET", "/login", [](const std::string& request) {
         // TODO: 实现用户登录逻辑
         return "Please use POST to login";
-    };
+    }, ExecutorKind::Inline);
 
-    // 修改POST路由逻辑
-    post_routes["/register"] = [](const std::string& request) {
+    // 修改POST路由逻辑：访问 SQLite 会阻塞，放到阻塞线程池
+    addRoute("POST", "/register", [](const std::string& request) {
         // 解析用户名和密码
         // 例如从请求中解析 username 和 password，这里需要您自己实现解析逻辑
         auto params = parseFormBody(request);
@@ -81,10 +94,10 @@ void setupRoutes() {
         } else {
             return "Register Failed!";
         }
-    };
+    }, ExecutorKind::Blocking);
 
-    // 登录路由
-    post_routes["/login"] = [](const std::string& request) {
+    // 登录路由（SQLite 查询 + SHA256），同样放到阻塞线程池，与静态路由和 CPU 任务隔离
+    addRoute("POST", "/login", [](const std::string& request) {
         // 解析用户名和密码
         auto params = parseFormBody(request);
         std::string username = params["username"];
@@ -96,18 +109,18 @@ void setupRoutes() {
         } else {
             return "Login Failed!";
         }
-    };
-        // 模拟 I/O 密集型任务
-    get_routes["/test_io"] = [](const std::string& request) {
+    }, ExecutorKind::Blocking);
+        // 模拟 I/O 密集型任务：阻塞线程池
+    addRoute("GET", "/test_io", [](const std::string& request) {
         // 模拟一个耗时的 I/O 操作（例如睡眠 100 毫秒）
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
         // 返回响应
         return "Test endpoint with simulated I/O delay";
-    };
+    }, ExecutorKind::Blocking);
 
-    // 模拟 CPU 密集型任务
-    get_routes["/test_cpu"] = [](const std::string& request) {
+    // 模拟 CPU 密集型任务：CPU 线程池
+    addRoute("GET", "/test_cpu", [](const std::string& request) {
         // 模拟一个CPU密集型任务，例如计算大量质数
         volatile long long sum = 0;  // 使用 volatile 防止编译器优化
         for (long long i = 2; i < 1000000; ++i) {
@@ -125,7 +138,7 @@ void setupRoutes() {
 
         // 返回响应
         return "Test endpoint with simulated CPU-intensive task";
-    };
+    }, ExecutorKind::Cpu);
      // TODO: 添加其他路径和处理函数
 }
 
@@ -152,16 +165,16 @@ std::tuple<std::string, std::string, std::string> parseHttpRequest(const std::st
 
 
 
-// 处理HTTP请求
-std::string handleHttpRequest(const std::string& method, const std::string& uri, const std::string& body) {
-    LOG_INFO("Handling HTTP request for URI: %s" , uri.c_str());  // 记录请求处理
-    if (method == "GET" && get_routes.count(uri) > 0) {
-        return get_routes[uri](body);
-    } else if (method == "POST" && post_routes.count(uri) > 0) {
-        return post_routes[uri](body);
-    } else {
-        return "404 Not Found";
+// 查找路由，找不到时返回 nullptr
+const Route* findRoute(const std::string& method, const std::string& uri) {
+    if (method == "GET") {
+        auto it = get_routes.find(uri);
+        if (it != get_routes.end()) return &it->second;
+    } else if (method == "POST") {
+        auto it = post_routes.find(uri);
+        if (it != post_routes.end()) return &it->second;
     }
+    return nullptr;
 }
 
 
@@ -182,30 +195,62 @@ void setNonBlocking(int sock) {
     }
 }
 
-void handleConnection(int fd) {
-    // 读取和处理请求的逻辑
+// 执行处理函数，发送响应并关闭连接（在路由指定的执行器上运行）
+void runHandler(int fd, const Route* route, const std::string& uri, const std::string& body) {
+    LOG_INFO("Handling HTTP request for URI: %s on %s executor", uri.c_str(), Executors::name(route->executor));
+    std::string response_body = route->handler(body);
+    std::string response = "HTTP/1.1 200 OK\nContent-Type: text/plain\n\n" + response_body;
+    send(fd, response.c_str(), response.length(), 0);
+
+    // 完成处理后关闭socket
+    close(fd);
+    LOG_INFO("Closed connection on fd %d", fd);
+}
+
+// 客户端 fd 以 EPOLLONESHOT 注册：每次事件之后自动停止监听，直到重新 arm
+// 请求交给执行器后 epoll 线程不会再收到这个 fd 的事件（对端 FIN、多余的数据），只有处理函数会 send/close 它
+void rearm(int epollfd, int fd) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET | EPOLLONESHOT;
+    ev.data.fd = fd;
+    if (epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+        LOG_ERROR("epoll_ctl rearm failed for fd %d", fd);
+        close(fd);
+    }
+}
+
+// 在 epoll 线程中读取并解析请求（非阻塞读取，开销很小），再按路由的执行器提示分发处理函数
+void handleConnection(int epollfd, int fd, Executors& executors) {
     char buffer[4096];
     ssize_t bytes_read = read(fd, buffer, sizeof(buffer) - 1);
 
-    if (bytes_read > 0) {
-        buffer[bytes_read] = '\0';
-        std::string request(buffer);
-        auto [method, uri, body] = parseHttpRequest(request);
-        std::string response_body = handleHttpRequest(method, uri, body);
-        std::string response = "HTTP/1.1 200 OK\nContent-Type: text/plain\n\n" + response_body;
-        send(fd, response.c_str(), response.length(), 0);
+    // 请求还没到（EAGAIN）：重新 arm，等下一次可读事件
+    if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        rearm(epollfd, fd);
+        return;
     }
-
     // 读取发生错误或连接被关闭
     if (bytes_read <= 0) {
-        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        if (bytes_read < 0) {
             LOG_ERROR("Read error or connection closed on fd %d", fd);
         }
+        close(fd);
+        return;
     }
 
-    // 完成处理后关闭socket
-    close(fd);
-    LOG_INFO("Closed connection on fd %d", fd);
+    buffer[bytes_read] = '\0';
+    std::string request(buffer);
+    auto [method, uri, body] = parseHttpRequest(request);
+    const Route* route = findRoute(method, uri);
+    if (route == nullptr) {
+        std::string response = "HTTP/1.1 200 OK\nContent-Type: text/plain\n\n404 Not Found";
+        send(fd, response.c_str(), response.length(), 0);
+        close(fd);
+        return;
+    }
+    executors.execute(route->executor, [fd, route, uri = uri, body = body]() {
+        runHandler(fd, route, uri, body);
+    });
 }
 
 
@@ -252,8 +297,11 @@ int main() {
     LOG_INFO("Server starting");
 
 
-    ThreadPool pool(16); // 创建含有16个线程的线程池
-    LOG_INFO("Thread pool created with 4 threads");
+    // CPU 线程池按核数创建，阻塞线程池更大（BLOCKING_THREADS 可配置），用于数据库和 I/O 等会阻塞的处理函数
+    size_t cpuThreads = Executors::defaultCpuThreads();
+    size_t blockingThreads = Executors::defaultBlockingThreads();
+    Executors executors(cpuThreads, blockingThreads);
+    LOG_INFO("Executors created: cpu=%zu threads, blocking=%zu threads", cpuThreads, blockingThreads);
 
    while (true) {
         int nfds = epoll_wait(epollfd, events, MAX_EVENTS, -1);
@@ -261,7 +309,7 @@ int main() {
             if (events[n].data.fd == server_fd) {
                 while ((new_socket = accept(server_fd, (struct sockaddr*)&address, (socklen_t*)&addrlen)) > 0) {
                     setNonBlocking(new_socket);
-                    ev.events = EPOLLIN | EPOLLET;
+                    ev.events = EPOLLIN | EPOLLET | EPOLLONESHOT; // 一个请求只分发一次，见 rearm()
                     ev.data.fd = new_socket;
                     if (epoll_ctl(epollfd, EPOLL_CTL_ADD, new_socket, &ev) == -1) {
                         LOG_ERROR("epoll_ctl failed for new socket");
@@ -274,11 +322,9 @@ int main() {
                     LOG_ERROR("Accept failed");
                 }
             } else {
-                // 将任务委派给线程池处理
-                pool.enqueue([fd = events[n].data.fd]() {
-                    handleConnection(fd);
-                });
-                
+                // 读取并解析请求，再按路由交给对应的执行器处理
+                handleConnection(epollfd, events[n].data.fd, executors);
+
             }
         }
     }
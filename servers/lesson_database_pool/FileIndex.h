@@ -0,0 +1,230 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "Logger.h"
+
+// 上传目录的文件名索引（/files 使用）
+// 启动时扫描一次目录，之后由 inotify 事件和上传路由增量维护，列目录不再每次遍历磁盘
+// 每次变化版本号加一；完整列表序列化一次后缓存，版本不变时直接返回，版本号同时用作 ETag
+// 以 '.' 开头的名字（BlobStore 的 .store 和临时文件）不计入索引
+class FileIndex {
+public:
+    explicit FileIndex(const std::string& dir)
+        : dir_(dir),
+          // 启动时间作为 ETag 前缀，重启后版本号从头计数也不会和旧 ETag 冲突
+          epoch_(std::chrono::duration_cast<std::chrono::seconds>(
+                     std::chrono::system_clock::now().time_since_epoch()).count()) {
+        // 先建立监视再扫描，扫描完才开始处理事件：扫描期间的变化留在 inotify 队列里，之后按顺序补上（重复的事件是幂等的）
+        inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        stopFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        bool watching = inotifyFd_ >= 0 && stopFd_ >= 0 &&
+                        inotify_add_watch(inotifyFd_, dir_.c_str(),
+                                          IN_CREATE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM) >= 0;
+        rescan();
+        if (watching) {
+            watcher_ = std::thread([this] { watch(); });
+        } else {
+            LOG_ERROR("inotify unavailable for %s, /files will only see uploads made by this server", dir_.c_str());
+        }
+    }
+
+    ~FileIndex() {
+        if (watcher_.joinable()) {
+            uint64_t one = 1;
+            ssize_t ignored = ::write(stopFd_, &one, sizeof(one));
+            (void)ignored;
+            watcher_.join();
+        }
+        if (inotifyFd_ >= 0) ::close(inotifyFd_);
+        if (stopFd_ >= 0) ::close(stopFd_);
+    }
+
+    FileIndex(const FileIndex&) = delete;
+    FileIndex& operator=(const FileIndex&) = delete;
+
+    // 上传路由写入后立即调用，不用等 inotify 事件（重复添加没有影响）
+    void add(const std::string& name) {
+        if (!isListed(name)) {
+            return;
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (names_.insert(name).second) {
+            ++version_;
+        }
+    }
+
+    void remove(const std::string& name) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (names_.erase(name)) {
+            ++version_;
+        }
+    }
+
+    // 当前版本对应的 ETag；同一版本下同一查询的结果相同
+    std::string etag() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return etagLocked();
+    }
+
+    // 完整列表（JSON 数组），版本不变时返回缓存的结果；etag 与返回的内容属于同一版本
+    std::shared_ptr<const std::string> all(std::string& etag) {
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            if (cached_ && cachedVersion_ == version_) {
+                etag = etagLocked();
+                return cached_;
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        etag = etagLocked();
+        if (!cached_ || cachedVersion_ != version_) {
+            auto json = std::make_shared<std::string>();
+            json->reserve(names_.size() * 24 + 2);
+            appendJsonArray(*json, names_.begin(), names_.end(), names_.size());
+            cached_ = std::move(json);
+            cachedVersion_ = version_;
+        }
+        return cached_;
+    }
+
+    // 按前缀过滤并分页：返回名字大于 after、以 prefix 开头的前 limit 个（按名字排序）
+    std::string list(const std::string& prefix, const std::string& after, size_t limit, std::string& etag) const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        etag = etagLocked();
+        auto begin = names_.lower_bound(std::max(prefix, after));
+        if (begin != names_.end() && *begin == after) {
+            ++begin; // after 本身在上一页
+        }
+        auto end = begin;
+        size_t count = 0;
+        while (end != names_.end() && count < limit && end->compare(0, prefix.size(), prefix) == 0) {
+            ++end;
+            ++count;
+        }
+        std::string json;
+        json.reserve(count * 24 + 2);
+        appendJsonArray(json, begin, end, count);
+        return json;
+    }
+
+private:
+    std::string dir_;
+    long long epoch_;
+    mutable std::shared_mutex mutex_;
+    std::set<std::string> names_; // 有序，前缀过滤和分页用 lower_bound
+    uint64_t version_ = 0;
+    std::shared_ptr<const std::string> cached_;
+    uint64_t cachedVersion_ = 0;
+
+    int inotifyFd_ = -1;
+    int stopFd_ = -1; // 析构时写入，唤醒监视线程退出
+    std::thread watcher_;
+
+    std::string etagLocked() const {
+        return "\"" + std::to_string(epoch_) + "-" + std::to_string(version_) + "\"";
+    }
+
+    static bool isListed(const std::string& name) {
+        return !name.empty() && name[0] != '.';
+    }
+
+    // 全量扫描：启动时，以及 inotify 事件队列溢出（丢了事件）时
+    void rescan() {
+        std::set<std::string> names;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(dir_, ec)) {
+            std::string name = entry.path().filename().string();
+            if (isListed(name) && entry.is_regular_file(ec)) {
+                names.insert(std::move(name));
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        names_.swap(names);
+        ++version_;
+    }
+
+    void watch() {
+        // 按 inotify_event 对齐的缓冲区，一次读出多个事件
+        alignas(struct inotify_event) char buffer[64 * 1024];
+        struct pollfd fds[2] = {{inotifyFd_, POLLIN, 0}, {stopFd_, POLLIN, 0}};
+        while (true) {
+            if (poll(fds, 2, -1) < 0) {
+                continue; // EINTR
+            }
+            if (fds[1].revents & POLLIN) {
+                return;
+            }
+            ssize_t len;
+            while ((len = ::read(inotifyFd_, buffer, sizeof(buffer))) > 0) {
+                for (char* p = buffer; p < buffer + len;) {
+                    auto* event = reinterpret_cast<struct inotify_event*>(p);
+                    p += sizeof(struct inotify_event) + event->len;
+                    if (event->mask & IN_Q_OVERFLOW) {
+                        LOG_WARNING("inotify queue overflow on %s, rescanning", dir_.c_str());
+                        rescan();
+                        continue;
+                    }
+                    if (event->len == 0 || (event->mask & IN_ISDIR)) {
+                        continue;
+                    }
+                    std::string name(event->name);
+                    if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                        add(name);
+                    } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                        remove(name);
+                    }
+                }
+            }
+        }
+    }
+
+    template <class It>
+    static void appendJsonArray(std::string& out, It begin, It end, size_t count) {
+        out += '[';
+        size_t i = 0;
+        for (It it = begin; it != end; ++it, ++i) {
+            out += '"';
+            appendJsonEscaped(out, *it);
+            out += '"';
+            if (i + 1 < count) {
+                out += ',';
+            }
+        }
+        out += ']';
+    }
+
+    // 把字符串按 JSON 规则转义后追加到 out
+    static void appendJsonEscaped(std::string& out, const std::string& value) {
+        for (char c : value) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        static const char kDigits[] = "0123456789abcdef";
+                        out += "\\u00";
+                        out += kDigits[(c >> 4) & 0x0f];
+                        out += kDigits[c & 0x0f];
+                    } else {
+                        out += c;
+                    }
+            }
+        }
+    }
+};
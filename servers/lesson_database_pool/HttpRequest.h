@@ -114,6 +114,19 @@ public:
         return query;
     }
 
+    // 获取查询参数，例如 /files?prefix=a 中的 prefix；不存在时返回空字符串
+    std::string getQueryParam(const std::string& name) const {
+        std::istringstream stream(query);
+        std::string pair;
+        while (std::getline(stream, pair, '&')) {
+            std::size_t pos = pair.find('=');
+            if (pair.substr(0, pos) == name) {
+                return pos == std::string::npos ? "" : pair.substr(pos + 1);
+            }
+        }
+        return "";
+    }
+
     // 返回完整 body（如果有）
     const std::string& getBody() const {
         return body;
@@ -57,6 +57,7 @@ private:
     std::string getStatusMessage() const {
         switch (statusCode) {
             case 200: return "OK";
+            case 304: return "Not Modified";
             case 404: return "Not Found";
             // ... 其他状态码 ...
             default: return "Unknown";
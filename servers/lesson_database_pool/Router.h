@@ -1,8 +1,13 @@
 #include "HttpRequest.h"
 #include "HttpResponse.h"
 #include "Database.h"
+#include "BlobStore.h"
+#include "FileIndex.h"
 #include <fstream>      // 用于文件读写
 #include <filesystem>   // C++17, 用于检查文件存在、创建目录等
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
 #include <sstream>
 // Router 类负责将特定的 HTTP 请求映射到相应的处理函数
 class Router {
@@ -54,38 +59,53 @@ public:
         });
     }
     void setupFileRoutes(const std::string& uploadDir = "uploads") {
-        // 确保上传目录存在，不存在则创建
-        std::filesystem::create_directories(uploadDir);
+        // 按内容寻址的存储：上传目录不存在时自动创建，启动时重建文件名索引
+        blobs = std::make_unique<BlobStore>(uploadDir);
+        // /files 的文件名索引：启动时扫描一次，之后由 inotify 和上传路由维护
+        fileIndex = std::make_unique<FileIndex>(uploadDir);
 
         // 路由1: 文件上传
-        addRoute("POST", "/upload", [this, uploadDir](const HttpRequest& req) {
+        // filename + filedata：按内容保存，内容已存在时不再写盘
+        // filename + digest：引用已有内容（客户端已知 SHA-256 时不用上传数据），内容不存在时返回 404
+        addRoute("POST", "/upload", [this](const HttpRequest& req) {
             if (req.getMethodString() != "POST") {
                 return HttpResponse::makeErrorResponse(405, "Method Not Allowed");
             }
-            // 解析POST表单数据：filename, filedata
+            // 解析POST表单数据：filename, filedata 或 filename, digest
             auto params = req.parseFormBody();
             if (params.find("filename") == params.end() ||
-                params.find("filedata") == params.end()) 
+                (params.find("filedata") == params.end() && params.find("digest") == params.end()))
             {
                 return HttpResponse::makeErrorResponse(400, "Missing filename or filedata");
             }
 
             std::string filename = params["filename"];
-            std::string filedata = params["filedata"];
-
-            // 构造存储路径
-            std::string filepath = uploadDir + "/" + filename;
+            if (!BlobStore::isValidName(filename)) {
+                return HttpResponse::makeErrorResponse(400, "Invalid filename");
+            }
 
-            // 将 filedata 写入到指定文件
             // 注意：这里是直接把文本写进去，若有二进制需另行处理
-            std::ofstream ofs(filepath, std::ios::binary);
-            if (!ofs.is_open()) {
-                return HttpResponse::makeErrorResponse(500, "Failed to open file on server");
+            BlobStore::Blob blob;
+            try {
+                if (params.find("filedata") != params.end()) {
+                    auto result = blobs->put(filename, params["filedata"]);
+                    blob = result.blob;
+                    LOG_INFO("Upload %s -> %s%s", filename.c_str(), blob.digest.c_str(),
+                             result.deduplicated ? " (deduplicated)" : "");
+                } else if (!BlobStore::isValidDigest(params["digest"]) ||
+                           !blobs->link(filename, params["digest"], blob)) {
+                    return HttpResponse::makeErrorResponse(404, "Unknown digest");
+                }
+            } catch (const std::exception& e) {
+                LOG_ERROR("Upload failed: %s", e.what());
+                return HttpResponse::makeErrorResponse(500, "Failed to store file on server");
             }
-            ofs << filedata;
-            ofs.close();
 
-            return HttpResponse::makeOkResponse("Upload Success: " + filename);
+            fileIndex->add(filename); // 不等 inotify 事件，上传后立即出现在 /files 中
+
+            HttpResponse response = HttpResponse::makeOkResponse("Upload Success: " + filename);
+            response.setHeader("ETag", "\"" + blob.digest + "\"");
+            return response;
         });
 
         // 路由2: 文件下载
@@ -124,12 +144,21 @@ public:
     std::string filename = value;
     std::string filepath = uploadDir + "/" + filename;
 
-    // 5) 检查文件存在性
-    if (!std::filesystem::exists(filepath)) {
+    // 5) 检查文件存在性（同时拿到内容摘要作为 ETag）
+    BlobStore::Blob blob;
+    if (!BlobStore::isValidName(filename) || !blobs->lookup(filename, blob)) {
         LOG_WARNING("File not found: %s", filepath.c_str());
         return HttpResponse::makeErrorResponse(404, "File Not Found");
     }
 
+    // 内容不变 ETag 就不变，客户端缓存命中时不用再传一遍
+    std::string etag = "\"" + blob.digest + "\"";
+    if (req.getHeader("If-None-Match") == etag) {
+        HttpResponse notModified(304);
+        notModified.setHeader("ETag", etag);
+        return notModified;
+    }
+
     // 6) 读取文件并构建响应
     std::ifstream ifs(filepath, std::ios::binary);
     if (!ifs.is_open()) {
@@ -144,6 +173,7 @@ public:
     HttpResponse response(200);
     response.setHeader("Content-Disposition", "attachment; filename=\"" + filename + "\"");
     response.setHeader("Content-Type", "application/octet-stream");
+    response.setHeader("ETag", etag);
     response.setBody(fileContent);
 
     LOG_INFO("Download success: %s (size=%zu bytes)", filepath.c_str(), fileContent.size());
@@ -151,31 +181,35 @@ public:
 });
 
         //路由3 查看文件
-        addRoute("GET", "/files", [uploadDir](const HttpRequest& req) {
-    // 遍历目录，收集所有常规文件的文件名
-    std::vector<std::string> filenames;
-    for (const auto& entry : std::filesystem::directory_iterator(uploadDir)) {
-        if (entry.is_regular_file()) {
-            // 只取最后的文件名，不要带路径
-            filenames.push_back(entry.path().filename().string());
-        }
+        // GET /files 返回全部文件名（JSON 数组，按名字排序）
+        // 可选参数：prefix 只返回以它开头的文件；limit 每页条数，after 为上一页最后一个文件名
+        addRoute("GET", "/files", [this](const HttpRequest& req) {
+    // 索引没有变化时客户端缓存仍然有效
+    std::string ifNoneMatch = req.getHeader("If-None-Match");
+    if (!ifNoneMatch.empty() && ifNoneMatch == fileIndex->etag()) {
+        HttpResponse notModified(304);
+        notModified.setHeader("ETag", ifNoneMatch);
+        return notModified;
     }
 
-    // 简单将其拼成 JSON 数组
-    // 这里手动组装，或可使用第三方 JSON 库如 nlohmann/json
-    std::ostringstream oss;
-    oss << "[";
-    for (size_t i = 0; i < filenames.size(); i++) {
-        oss << "\"" << filenames[i] << "\"";
-        if (i + 1 < filenames.size()) {
-            oss << ",";
-        }
+    std::string prefix = req.getQueryParam("prefix");
+    std::string after = req.getQueryParam("after");
+    std::string limitParam = req.getQueryParam("limit");
+    size_t limit = limitParam.empty() ? SIZE_MAX : std::strtoul(limitParam.c_str(), nullptr, 10);
+    if (limit == 0) {
+        return HttpResponse::makeErrorResponse(400, "Invalid limit");
     }
-    oss << "]";
 
     HttpResponse resp(200);
     resp.setHeader("Content-Type", "application/json");
-    resp.setBody(oss.str());
+    std::string etag;
+    if (prefix.empty() && after.empty() && limitParam.empty()) {
+        // 完整列表直接使用缓存的序列化结果
+        resp.setBody(*fileIndex->all(etag));
+    } else {
+        resp.setBody(fileIndex->list(prefix, after, limit, etag));
+    }
+    resp.setHeader("ETag", etag);
     return resp;
 });
 
@@ -205,4 +239,6 @@ addRoute("GET", "/index", [this](const HttpRequest& req) {
     }
 private:
     std::unordered_map<std::string, HandlerFunc> routes;  // 存储路由映射
+    std::unique_ptr<BlobStore> blobs;                      // 上传文件的内容存储
+    std::unique_ptr<FileIndex> fileIndex;                  // /files 的文件名索引
 };